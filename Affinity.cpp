@@ -0,0 +1,151 @@
+#include "Affinity.h"
+#include <sched.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+// ******************************************************************
+// ********************** typedefs & structs ************************
+// ******************************************************************
+
+#define MAX_NODES 64
+#define NODE_PATH "/sys/devices/system/node/node%d/cpulist"
+
+typedef struct Topology {
+    // usable cpus of every node, nodes without usable cpus are dropped
+    std::vector<std::vector<int>> node_cpus;
+    // all usable cpus, node by node (COMPACT order)
+    std::vector<CpuPlacement> compact;
+    // all usable cpus, one per node in turn (SCATTER order)
+    std::vector<CpuPlacement> scatter;
+} Topology;
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+// parses a sysfs cpu list such as "0-3,8-11"
+static std::vector<int> parseCpuList(FILE *file) {
+    std::vector<int> cpus;
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1) {
+        last = first;
+        int c = fgetc(file);
+        if (c == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            c = fgetc(file);
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    return cpus;
+}
+
+static Topology loadTopology() {
+    Topology topology;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return topology;
+    }
+
+    char path[128];
+    for (int node = 0; node < MAX_NODES; ++node) {
+        snprintf(path, sizeof(path), NODE_PATH, node);
+        FILE *file = fopen(path, "r");
+        if (file == nullptr) {
+            continue;
+        }
+        std::vector<int> usable;
+        for (int cpu: parseCpuList(file)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                usable.push_back(cpu);
+            }
+        }
+        fclose(file);
+        if (not usable.empty()) {
+            topology.node_cpus.push_back(usable);
+        }
+    }
+
+    // no NUMA information (or a kernel without sysfs nodes): one node
+    if (topology.node_cpus.empty()) {
+        std::vector<int> usable;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                usable.push_back(cpu);
+            }
+        }
+        topology.node_cpus.push_back(usable);
+    }
+
+    size_t widest = 0;
+    for (size_t node = 0; node < topology.node_cpus.size(); ++node) {
+        for (int cpu: topology.node_cpus[node]) {
+            topology.compact.push_back({cpu, (int) node, false});
+        }
+        widest = std::max(widest, topology.node_cpus[node].size());
+    }
+    for (size_t i = 0; i < widest; ++i) {
+        for (size_t node = 0; node < topology.node_cpus.size(); ++node) {
+            if (i < topology.node_cpus[node].size()) {
+                topology.scatter.push_back({topology.node_cpus[node][i],
+                                            (int) node, false});
+            }
+        }
+    }
+    return topology;
+}
+
+static const Topology &topology() {
+    // function-local static: initialized once, thread safe since C++11
+    static const Topology instance = loadTopology();
+    return instance;
+}
+
+// ******************************************************************
+// *********************** Affinity functions ***********************
+// ******************************************************************
+
+CpuPlacement affinityPlacement(affinity_policy_t policy, int thread_index) {
+    const std::vector<CpuPlacement> *order = nullptr;
+    if (policy == AFFINITY_COMPACT) {
+        order = &topology().compact;
+    } else if (policy == AFFINITY_SCATTER) {
+        order = &topology().scatter;
+    }
+    if (order == nullptr or order->empty()) {
+        return {-1, 0, false};
+    }
+    return (*order)[thread_index % order->size()];
+}
+
+CpuPlacement affinityNodePlacement(affinity_policy_t policy, int node) {
+    if (policy == AFFINITY_NONE || node < 0
+        || node >= (int) topology().node_cpus.size()) {
+        return {-1, 0, false};
+    }
+    return {-1, node, true};
+}
+
+void affinityApply(pthread_attr_t *attr, const CpuPlacement &placement) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (placement.cpu >= 0) {
+        CPU_SET(placement.cpu, &cpus);
+    } else if (placement.whole_node) {
+        for (int cpu: topology().node_cpus[placement.node]) {
+            CPU_SET(cpu, &cpus);
+        }
+    } else {
+        return;
+    }
+    pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus);
+}
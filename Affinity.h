@@ -0,0 +1,43 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <pthread.h>
+#include "MapReduceFramework.h"
+
+/*
+    Description: CpuPlacement is where a worker thread was placed by the
+    affinity policy: the cpu it is pinned to and that cpu's NUMA node.
+    cpu is -1 when the thread isn't pinned to one cpu: with whole_node it
+    may run on any cpu of node, otherwise it is left unpinned (node is
+    then 0).
+*/
+typedef struct CpuPlacement {
+    int cpu;
+    int node;
+    bool whole_node;
+} CpuPlacement;
+
+/*
+    Description: affinityPlacement returns the placement of worker number
+    thread_index under the given policy. The machine topology is read once
+    from /sys/devices/system/node and restricted to the cpus the process is
+    allowed to run on.
+*/
+CpuPlacement affinityPlacement(affinity_policy_t policy, int thread_index);
+
+/*
+    Description: affinityNodePlacement returns a placement on every cpu of
+    node, for a thread that should stay near the memory of node without
+    taking the cpu of a worker placed there. Unpinned under AFFINITY_NONE.
+*/
+CpuPlacement affinityNodePlacement(affinity_policy_t policy, int node);
+
+/*
+    Description: affinityApply sets the cpu (or the node's cpus) of
+    placement on the thread attributes so the thread starts (and
+    first-touches its memory) there. Does nothing for an unpinned
+    placement.
+*/
+void affinityApply(pthread_attr_t *attr, const CpuPlacement &placement);
+
+#endif //AFFINITY_H
@@ -0,0 +1,106 @@
+#include "Arena.h"
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#define FIRST_BLOCK_SIZE (64 * 1024)
+#define MAX_BLOCK_SIZE (4 * 1024 * 1024)
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+static char *alignUp(char *pointer, size_t alignment) {
+    uintptr_t address = (uintptr_t) pointer;
+    return (char *) ((address + alignment - 1) & ~(uintptr_t) (alignment - 1));
+}
+
+// ******************************************************************
+// *********************** Arena functions **************************
+// ******************************************************************
+
+Arena::Arena()
+        : blocks(nullptr), cursor(nullptr), end(nullptr),
+          next_block_size(FIRST_BLOCK_SIZE) {}
+
+Arena::~Arena() {
+    release();
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+    char *result = alignUp(cursor, alignment);
+    if (cursor != nullptr && result + size <= end) {
+        cursor = result + size;
+        return result;
+    }
+    return allocateBlock(size, alignment);
+}
+
+// starts a new block, blocks double in size up to MAX_BLOCK_SIZE and an
+// allocation larger than that gets a block of its own
+void *Arena::allocateBlock(size_t size, size_t alignment) {
+    size_t needed = sizeof(Block) + alignment + size;
+    size_t block_size = next_block_size;
+    if (block_size < needed) {
+        block_size = needed;
+    }
+    Block *block = (Block *) malloc(block_size);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    block->next = blocks;
+    blocks = block;
+    if (next_block_size < MAX_BLOCK_SIZE) {
+        next_block_size *= 2;
+    }
+
+    char *result = alignUp((char *) (block + 1), alignment);
+    cursor = result + size;
+    end = (char *) block + block_size;
+    return result;
+}
+
+void Arena::addDestructor(void (*destroy)(void *), void *object) {
+    destructors.push_back({destroy, object});
+}
+
+void Arena::release() {
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+        it->destroy(it->object);
+    }
+    destructors.clear();
+    while (blocks != nullptr) {
+        Block *next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+    cursor = nullptr;
+    end = nullptr;
+    next_block_size = FIRST_BLOCK_SIZE;
+}
+
+void Arena::swap(Arena &other) {
+    std::swap(blocks, other.blocks);
+    std::swap(cursor, other.cursor);
+    std::swap(end, other.end);
+    std::swap(next_block_size, other.next_block_size);
+    destructors.swap(other.destructors);
+}
+
+void Arena::reset() {
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+        it->destroy(it->object);
+    }
+    destructors.clear();
+    if (blocks == nullptr) {
+        return;
+    }
+    // the newest block is the largest, keep it
+    while (blocks->next != nullptr) {
+        Block *next = blocks->next->next;
+        free(blocks->next);
+        blocks->next = next;
+    }
+    cursor = (char *) (blocks + 1);
+}
@@ -0,0 +1,76 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+    Description: Arena is a bump allocator owned by a single thread of a job.
+    Allocations are carved out of large blocks and are never freed one by
+    one; release() drops all of them at once. Objects that need their
+    destructor run register it with addDestructor, trivially destructible
+    objects cost nothing to release.
+*/
+class Arena {
+public:
+    Arena();
+
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    /*
+        Description: allocate returns size bytes aligned to alignment (a power
+        of two). Throws std::bad_alloc if the system is out of memory.
+    */
+    void *allocate(size_t size, size_t alignment);
+
+    /*
+        Description: addDestructor makes release() call destroy(object).
+        Destructors run in reverse order of registration.
+    */
+    void addDestructor(void (*destroy)(void *), void *object);
+
+    /*
+        Description: release runs the registered destructors and frees every
+        block. The arena can be used again afterwards.
+    */
+    void release();
+
+    /*
+        Description: reset runs the registered destructors and frees every
+        block but the current one, which the next allocations reuse from
+        its start. For an arena that holds short-lived objects it saves the
+        malloc of a fresh block every time.
+    */
+    void reset();
+
+    /*
+        Description: swap exchanges the blocks and destructors of this arena
+        with other's, so the objects allocated from one outlive it in the
+        other.
+    */
+    void swap(Arena &other);
+
+private:
+    typedef struct Block {
+        Block *next;
+    } Block;
+
+    typedef struct Destructor {
+        void (*destroy)(void *);
+        void *object;
+    } Destructor;
+
+    void *allocateBlock(size_t size, size_t alignment);
+
+    Block *blocks;
+    char *cursor;
+    char *end;
+    size_t next_block_size;
+    std::vector<Destructor> destructors;
+};
+
+#endif //ARENA_H
@@ -0,0 +1,148 @@
+/**
+ * compactbench: a test2-style job (every input number emits (n, 1)) with
+ * the pairs as objects against the same job as a CompactMapReduceClient.
+ * Each job runs in its own child process so the peak memory it adds on top
+ * of the input (ru_maxrss) is its own.
+ *
+ * usage: compactbench [numbers] [threads]
+ */
+#include "MapReduceFramework.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#define RANGE 100000
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    Number(int n) : n(n) {}
+
+    bool operator<(const K1 &other) const { return n < ((const Number &) other).n; }
+
+    bool operator<(const K2 &other) const { return n < ((const Number &) other).n; }
+
+    bool operator<(const K3 &other) const { return n < ((const Number &) other).n; }
+
+    int n;
+};
+
+template<>
+struct arena_skips_destructor<Number> : std::true_type {};
+
+static void reduceNumbers(const IntermediateVec *pairs, void *context) {
+    int count = 0;
+    for (const IntermediatePair &pair: *pairs) {
+        count += ((const Number *) pair.second)->n;
+    }
+    emit3(new Number(((const Number *) pairs->at(0).first)->n), new Number(count),
+          context);
+}
+
+// the pairs of test2: two separately allocated objects per pair
+class ObjectClient : public MapReduceClient {
+public:
+    void map(const K1 *key, const V1 *value, void *context) const {
+        (void) value;
+        emit2(new Number(((const Number *) key)->n), new Number(1), context);
+    }
+
+    void reduce(const IntermediateVec *pairs, void *context) const {
+        reduceNumbers(pairs, context);
+        for (const IntermediatePair &pair: *pairs) {
+            delete pair.first;
+            delete pair.second;
+        }
+    }
+};
+
+class CompactClient : public CompactMapReduceClient {
+public:
+    void map(const K1 *key, const V1 *value, void *context) const {
+        (void) value;
+        Number k(((const Number *) key)->n);
+        Number one(1);
+        emit2(&k, &one, context);
+    }
+
+    void reduce(const IntermediateVec *pairs, void *context) const {
+        reduceNumbers(pairs, context);
+    }
+
+    // non-negative ints, big endian keeps their order
+    void serializeKey(const K2 *key, std::vector<char> *out) const {
+        uint32_t n = (uint32_t) ((const Number *) key)->n;
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out->push_back((char) (n >> shift));
+        }
+    }
+
+    void serializeValue(const V2 *value, std::vector<char> *out) const {
+        out->push_back((char) ((const Number *) value)->n);
+    }
+
+    K2 *deserializeKey(const char *data, size_t size, void *context) const {
+        (void) size;
+        uint32_t n = 0;
+        for (int i = 0; i < 4; i++) {
+            n = (n << 8) | (uint8_t) data[i];
+        }
+        return emitAlloc<Number>(context, (int) n);
+    }
+
+    V2 *deserializeValue(const char *data, size_t size, void *context) const {
+        (void) size;
+        return emitAlloc<Number>(context, (int) data[0]);
+    }
+};
+
+static long maxRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void runJob(const MapReduceClient &client, const char *name, int numbers,
+                   int threads) {
+    InputVec input;
+    srand(0);
+    for (int i = 0; i < numbers; i++) {
+        input.push_back({new Number(rand() % RANGE), nullptr});
+    }
+    long before = maxRssKb();
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, threads);
+    waitForJob(job);
+    closeJobHandle(job);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    long added = maxRssKb() - before;
+    printf("%-8s %8.1f MB peak over input (%5.1f bytes/pair) %8.0fms\n", name,
+           added / 1024.0, added * 1024.0 / numbers, seconds * 1e3);
+}
+
+int main(int argc, char **argv) {
+    int numbers = argc > 1 ? atoi(argv[1]) : 10000000;
+    int threads = argc > 2 ? atoi(argv[2]) : 5;
+    printf("%d pairs, %d threads\n", numbers, threads);
+    for (int mode = 0; mode < 2; mode++) {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            if (mode == 0) {
+                runJob(ObjectClient(), "objects", numbers, threads);
+            } else {
+                runJob(CompactClient(), "compact", numbers, threads);
+            }
+            exit(0);
+        }
+        waitpid(child, nullptr, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * Per-thread context layout benchmark.
+ *
+ * part 1 - every thread appends to its own IntermediateVec, once with the
+ * vector headers packed next to each other (the old std::vector layout) and
+ * once with each header on its own cache line (PaddedArray).
+ * part 2 - a test1 style counting job at growing multiThreadLevel.
+ */
+#include "MapReduceFramework.h"
+#include "PaddedArray.h"
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#define PUSHES_PER_THREAD 200000
+#define JOB_SIZE 100000
+#define RANGE 200
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ******************************************************************
+// ********************** part 1: buffer layout *********************
+// ******************************************************************
+
+typedef struct PushContext {
+    IntermediateVec *vec;
+    long *counter;
+} PushContext;
+
+static void *pushLoop(void *arg) {
+    PushContext *context = (PushContext *) arg;
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < PUSHES_PER_THREAD; ++i) {
+            context->vec->push_back(IntermediatePair(nullptr, nullptr));
+            ++*context->counter;
+        }
+        // keep the capacity, so later rounds only touch the header
+        context->vec->clear();
+    }
+    return nullptr;
+}
+
+static double runPushes(std::vector<IntermediateVec *> &vecs,
+                        std::vector<long *> &counters) {
+    int threads = (int) vecs.size();
+    std::vector<pthread_t> ids(threads);
+    std::vector<PushContext> contexts(threads);
+    double begin = nowSeconds();
+    for (int i = 0; i < threads; ++i) {
+        contexts[i] = {vecs[i], counters[i]};
+        pthread_create(&ids[i], NULL, pushLoop, &contexts[i]);
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(ids[i], NULL);
+    }
+    return nowSeconds() - begin;
+}
+
+static void benchLayout(int threads) {
+    std::vector<IntermediateVec> packed(threads);
+    std::vector<long> packed_counters(threads, 0);
+    std::vector<IntermediateVec *> vecs(threads);
+    std::vector<long *> counters(threads);
+    for (int i = 0; i < threads; ++i) {
+        vecs[i] = &packed[i];
+        counters[i] = &packed_counters[i];
+    }
+    double packed_time = runPushes(vecs, counters);
+
+    PaddedArray<IntermediateVec> padded(threads);
+    PaddedArray<long> padded_counters(threads);
+    for (int i = 0; i < threads; ++i) {
+        vecs[i] = &padded[i];
+        padded_counters[i] = 0;
+        counters[i] = &padded_counters[i];
+    }
+    double padded_time = runPushes(vecs, counters);
+
+    printf("layout  threads %4d  packed %8.3f s  padded %8.3f s  (x%.2f)\n",
+           threads, packed_time, padded_time, packed_time / padded_time);
+}
+
+// ******************************************************************
+// ********************** part 2: whole job *************************
+// ******************************************************************
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    explicit Number(int n) : n(n) {}
+
+    bool operator<(const K1 &other) const { return n < ((Number &) other).n; }
+
+    bool operator<(const K2 &other) const { return n < ((Number &) other).n; }
+
+    bool operator<(const K3 &other) const { return n < ((Number &) other).n; }
+};
+
+struct CountClient : public MapReduceClient {
+    void map(const K1 *key, const V1 *, void *context) const {
+        emit2(new Number(((Number *) key)->n), new Number(1), context);
+    }
+
+    void reduce(const IntermediateVec *pairs, void *context) const {
+        int n = ((Number *) pairs->at(0).first)->n;
+        for (const IntermediatePair &pair: *pairs) {
+            delete pair.first;
+            delete pair.second;
+        }
+        emit3(new Number(n), new Number((int) pairs->size()), context);
+    }
+};
+
+static void benchJob(int threads) {
+    InputVec input;
+    srand(0);
+    for (int i = 0; i < JOB_SIZE; ++i) {
+        input.push_back(InputPair(new Number(rand() % RANGE), nullptr));
+    }
+    CountClient client;
+    OutputVec output;
+    double begin = nowSeconds();
+    JobHandle job = startMapReduceJob(client, input, output, threads);
+    waitForJob(job);
+    closeJobHandle(job);
+    printf("job     threads %4d  %8.3f s  (%zu keys)\n",
+           threads, nowSeconds() - begin, output.size());
+    for (OutputPair &pair: output) {
+        delete pair.first;
+        delete pair.second;
+    }
+    for (InputPair &pair: input) {
+        delete pair.first;
+    }
+}
+
+int main() {
+    const int levels[] = {1, 4, 16, 64, 400};
+    for (int threads: levels) {
+        benchLayout(threads);
+    }
+    for (int threads: levels) {
+        benchJob(threads);
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * histbench: the byte-by-byte histogram loop of CounterClient::map against
+ * byteHistogram, on random bytes and on text with long runs of
+ * the same few letters (where a single table serializes on one counter).
+ */
+#include "ByteHistogram.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#define DATA_SIZE (64 * 1024 * 1024)
+#define ROUNDS 5
+
+static double seconds(const struct timespec &begin) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+}
+
+// the loop CounterClient::map used before byteHistogram
+static void scalarLoop(const unsigned char *data, size_t size,
+                       uint32_t counts[HISTOGRAM_BINS]) {
+    for (size_t i = 0; i < size; i++) {
+        counts[data[i]]++;
+    }
+}
+
+static void run(const char *name, const std::vector<unsigned char> &data,
+                const uint32_t *expected, bool loop) {
+    uint32_t counts[HISTOGRAM_BINS];
+    double best = 1e9;
+    for (int round = 0; round < ROUNDS; round++) {
+        memset(counts, 0, sizeof(counts));
+        struct timespec begin;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        if (loop) {
+            scalarLoop(data.data(), data.size(), counts);
+        } else {
+            byteHistogram(data.data(), data.size(), counts);
+        }
+        double elapsed = seconds(begin);
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    if (expected != nullptr && memcmp(counts, expected, sizeof(counts)) != 0) {
+        printf("%-8s WRONG COUNTS\n", name);
+        exit(EXIT_FAILURE);
+    }
+    printf("%-8s %8.0f MB/s\n", name, data.size() / best / 1e6);
+}
+
+static void bench(const char *title, const std::vector<unsigned char> &data) {
+    uint32_t expected[HISTOGRAM_BINS] = {0};
+    scalarLoop(data.data(), data.size(), expected);
+    printf("%s (%zu MB)\n", title, data.size() >> 20);
+    run("loop", data, nullptr, true);
+    run("words", data, expected, false);
+}
+
+int main() {
+    std::vector<unsigned char> data(DATA_SIZE);
+    srand(0);
+    for (unsigned char &byte: data) {
+        byte = (unsigned char) rand();
+    }
+    bench("random bytes", data);
+
+    for (size_t i = 0; i < data.size();) {
+        unsigned char letter = (unsigned char) ("aeiou "[rand() % 6]);
+        size_t run_length = 1 + rand() % 16;
+        for (; run_length > 0 && i < data.size(); run_length--) {
+            data[i++] = letter;
+        }
+    }
+    printf("\n");
+    bench("runs of few letters", data);
+    return 0;
+}
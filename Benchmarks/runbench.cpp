@@ -0,0 +1,202 @@
+/**
+ * runbench: compressed runs on the test2 prime workload (N numbers below
+ * RANGE, every prime p emits (p, 1)) as a CompactMapReduceClient.
+ * First the run format alone: one sorted run of the workload's records is
+ * front coded and compressed, reporting its size and the encode and decode
+ * throughput. Then whole jobs with compress_runs off and on, each in its
+ * own child process for its peak memory over the input (ru_maxrss).
+ *
+ * usage: runbench [numbers] [threads]
+ */
+#include "MapReduceFramework.h"
+#include "CompressedRun.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+
+#define RANGE 100000
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    Number(int n) : n(n) {}
+
+    bool operator<(const K1 &other) const { return n < ((const Number &) other).n; }
+
+    bool operator<(const K2 &other) const { return n < ((const Number &) other).n; }
+
+    bool operator<(const K3 &other) const { return n < ((const Number &) other).n; }
+
+    int n;
+};
+
+template<>
+struct arena_skips_destructor<Number> : std::true_type {};
+
+static bool isPrime(int n) {
+    if (n < 2) {
+        return n == 1;  // test2 counts 1 as a prime
+    }
+    for (int i = 2; i * i <= n; i++) {
+        if (n % i == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void writeKey(int n, std::vector<char> *out) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out->push_back((char) ((uint32_t) n >> shift));
+    }
+}
+
+class PrimeClient : public CompactMapReduceClient {
+public:
+    void map(const K1 *key, const V1 *value, void *context) const {
+        (void) value;
+        int n = ((const Number *) key)->n;
+        if (isPrime(n)) {
+            Number k(n);
+            Number one(1);
+            emit2(&k, &one, context);
+        }
+    }
+
+    void reduce(const IntermediateVec *pairs, void *context) const {
+        int count = 0;
+        for (const IntermediatePair &pair: *pairs) {
+            count += ((const Number *) pair.second)->n;
+        }
+        emit3(new Number(((const Number *) pairs->at(0).first)->n),
+              new Number(count), context);
+    }
+
+    void serializeKey(const K2 *key, std::vector<char> *out) const {
+        writeKey(((const Number *) key)->n, out);
+    }
+
+    void serializeValue(const V2 *value, std::vector<char> *out) const {
+        out->push_back((char) ((const Number *) value)->n);
+    }
+
+    K2 *deserializeKey(const char *data, size_t size, void *context) const {
+        (void) size;
+        uint32_t n = 0;
+        for (int i = 0; i < 4; i++) {
+            n = (n << 8) | (uint8_t) data[i];
+        }
+        return emitAlloc<Number>(context, (int) n);
+    }
+
+    V2 *deserializeValue(const char *data, size_t size, void *context) const {
+        (void) size;
+        return emitAlloc<Number>(context, (int) data[0]);
+    }
+};
+
+static double seconds(const struct timespec &begin) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+}
+
+static void benchFormat(int numbers) {
+    // the run a single map thread would produce
+    Arena pages;
+    RecordVec records;
+    std::vector<char> bytes;
+    srand(0);
+    for (int i = 0; i < numbers; i++) {
+        int n = rand() % RANGE;
+        if (isPrime(n)) {
+            bytes.clear();
+            writeKey(n, &bytes);
+            bytes.push_back(1);
+            records.push_back(compactWriteRecord(&pages, bytes.data(), 4, 1));
+        }
+    }
+    std::sort(records.begin(), records.end(),
+              [](CompactRecord record1, CompactRecord record2) {
+                  RecordView view1 = compactReadRecord(record1);
+                  RecordView view2 = compactReadRecord(record2);
+                  return memcmp(view1.key, view2.key, 4) < 0;
+              });
+    // a record takes 2 size bytes, its key, its value and a pointer in the run
+    size_t record_bytes = records.size() * (2 + 4 + 1 + sizeof(CompactRecord));
+
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    CompressedRun run;
+    compressRun(records, &run);
+    double encode = seconds(begin);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    size_t read = 0;
+    for (RunReader reader(run); reader.valid(); reader.next()) {
+        read += reader.current().value_size;
+    }
+    double decode = seconds(begin);
+    if (read != records.size()) {
+        printf("THE RUN LOST RECORDS\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("run of %zu records\n", records.size());
+    printf("  records     %8.2f MB\n", record_bytes / 1e6);
+    printf("  front coded %8.2f MB\n", run.raw_bytes / 1e6);
+    printf("  compressed  %8.2f MB (%.1fx smaller than the records)\n",
+           run.bytes.size() / 1e6, (double) record_bytes / run.bytes.size());
+    printf("  encode %7.0f Mrecords/s, decode %7.0f Mrecords/s\n\n",
+           records.size() / encode / 1e6, records.size() / decode / 1e6);
+}
+
+static long maxRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void runJob(bool compress_runs, int numbers, int threads) {
+    InputVec input;
+    srand(0);
+    for (int i = 0; i < numbers; i++) {
+        input.push_back({new Number(rand() % RANGE), nullptr});
+    }
+    long before = maxRssKb();
+
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    PrimeClient client;
+    OutputVec output;
+    JobOptions options;
+    options.compress_runs = compress_runs;
+    JobHandle job = startMapReduceJob(client, input, output, threads, options);
+    waitForJob(job);
+    closeJobHandle(job);
+    double elapsed = seconds(begin);
+
+    printf("%-12s %8.1f MB peak over input %8.0fms, %zu primes\n",
+           compress_runs ? "compressed" : "records",
+           (maxRssKb() - before) / 1024.0, elapsed * 1e3, output.size());
+}
+
+int main(int argc, char **argv) {
+    int numbers = argc > 1 ? atoi(argv[1]) : 10000000;
+    int threads = argc > 2 ? atoi(argv[2]) : 5;
+    printf("%d numbers below %d, %d threads\n\n", numbers, RANGE, threads);
+    benchFormat(numbers);
+    for (int mode = 0; mode < 2; mode++) {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            runJob(mode == 1, numbers, threads);
+            exit(0);
+        }
+        waitpid(child, nullptr, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * sortbench: std::sort, which map threads used to sort their runs with,
+ * against naturalSort on runs of test1-style pairs (an int key compared
+ * through the virtual K2::operator<) that are random, sorted, reverse
+ * sorted, sorted with a few percent of the pairs out of place, and made of
+ * sorted blocks (the runs of a thread that mapped several input ranges).
+ *
+ * usage: sortbench [pairs]
+ */
+#include "MapReduceFramework.h"
+#include "NaturalSort.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#define ROUNDS 3
+#define BLOCKS 16
+
+struct Number : public K2, public V2 {
+    Number(int n) : n(n) {}
+
+    bool operator<(const K2 &other) const { return n < ((const Number &) other).n; }
+
+    int n;
+};
+
+static bool comparePairs(const IntermediatePair &pair1,
+                         const IntermediatePair &pair2) {
+    return *pair1.first < *pair2.first;
+}
+
+static double seconds(const struct timespec &begin) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+}
+
+static double best(const IntermediateVec &input, bool natural) {
+    double fastest = 1e9;
+    for (int round = 0; round < ROUNDS; round++) {
+        IntermediateVec run = input;
+        struct timespec begin;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        if (natural) {
+            naturalSort(run.begin(), run.end(), comparePairs);
+        } else {
+            std::sort(run.begin(), run.end(), comparePairs);
+        }
+        double elapsed = seconds(begin);
+        if (not std::is_sorted(run.begin(), run.end(), comparePairs)) {
+            printf("NOT SORTED\n");
+            exit(EXIT_FAILURE);
+        }
+        fastest = std::min(fastest, elapsed);
+    }
+    return fastest;
+}
+
+static void bench(const char *name, const std::vector<int> &keys) {
+    std::vector<Number> numbers(keys.begin(), keys.end());
+    IntermediateVec input;
+    for (Number &number: numbers) {
+        input.emplace_back(&number, nullptr);
+    }
+    double sorted = best(input, false);
+    double natural = best(input, true);
+    printf("%-10s std::sort %8.1fms  naturalSort %8.1fms  (x%.2f)\n", name,
+           sorted * 1e3, natural * 1e3, sorted / natural);
+}
+
+int main(int argc, char **argv) {
+    int pairs = argc > 1 ? atoi(argv[1]) : 2000000;
+    printf("%d pairs\n", pairs);
+    srand(0);
+    std::vector<int> keys(pairs);
+    for (int &key: keys) {
+        key = rand();
+    }
+    bench("random", keys);
+
+    std::sort(keys.begin(), keys.end());
+    std::vector<int> sorted = keys;
+    bench("sorted", keys);
+
+    std::reverse(keys.begin(), keys.end());
+    bench("reversed", keys);
+
+    keys = sorted;
+    for (int i = 0; i < pairs / 50; i++) {
+        keys[rand() % pairs] = rand();
+    }
+    bench("2% moved", keys);
+
+    for (int block = 0; block < BLOCKS; block++) {
+        for (int i = block; i < pairs; i += BLOCKS) {
+            keys[i / BLOCKS + block * (pairs / BLOCKS)] = sorted[i];
+        }
+    }
+    bench("16 blocks", keys);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * wordbench: the word frequency client of testsoldd/test4 (a Line per text
+ * line, split with std::stringstream and a new Word per word) against
+ * WordCountClient (tokenizeWords on 64KB chunks, counted per chunk), with
+ * views of the text as keys and with interned keys, on the files of
+ * testsoldd/TextFiles. Each file is repeated to make the job long
+ * enough to time; both clients must find the same frequencies.
+ *
+ * usage: wordbench [text files directory] [repeat]
+ */
+#include "MapReduceFramework.h"
+#include "WordCountClient.h"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#define THREADS 10
+#define CHUNK_SIZE (64 * 1024)
+
+static double seconds(const struct timespec &begin) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+}
+
+// ******************************************************************
+// the client of testsoldd/test4
+// ******************************************************************
+
+class Line : public K1 {
+public:
+    Line(const std::string &line) : line(line) {}
+
+    virtual bool operator<(const K1 &other) const {
+        return line < static_cast<const Line &>(other).line;
+    }
+
+    std::string line;
+};
+
+class Word : public K2, public K3 {
+public:
+    Word(const std::string &word) : word(word) {}
+
+    virtual bool operator<(const K2 &other) const {
+        return word < static_cast<const Word &>(other).word;
+    }
+
+    virtual bool operator<(const K3 &other) const {
+        return word < static_cast<const Word &>(other).word;
+    }
+
+    std::string word;
+};
+
+class Integer : public V3 {
+public:
+    Integer(int val) : val(val) {}
+
+    int val;
+};
+
+class StreamClient : public MapReduceClient {
+public:
+    void map(const K1 *key, const V1 *value, void *context) const {
+        (void) value;
+        std::stringstream sstream(static_cast<const Line *>(key)->line);
+        std::string word;
+        while (sstream >> word) {
+            emit2(new Word(word), nullptr, context);
+        }
+    }
+
+    void reduce(const IntermediateVec *pairs, void *context) const {
+        Word *k3 = new Word(*static_cast<const Word *>(pairs->at(0).first));
+        Integer *frequency = new Integer((int) pairs->size());
+        for (const IntermediatePair &pair: *pairs) {
+            delete pair.first;
+        }
+        emit3(k3, frequency, context);
+    }
+};
+
+// ******************************************************************
+
+typedef std::map<std::string, int> Frequencies;
+
+static double runStream(const std::string &text, Frequencies *frequencies) {
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    InputVec input;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        input.push_back({new Line(line), nullptr});
+    }
+    StreamClient client;
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, THREADS);
+    waitForJob(job);
+    closeJobHandle(job);
+    double elapsed = seconds(begin);
+
+    for (OutputPair &pair: output) {
+        (*frequencies)[static_cast<Word *>(pair.first)->word] =
+                static_cast<Integer *>(pair.second)->val;
+        delete pair.first;
+        delete pair.second;
+    }
+    for (InputPair &pair: input) {
+        delete pair.first;
+    }
+    return elapsed;
+}
+
+static double runTokenizer(const std::string &text, bool intern_keys,
+                           Frequencies *frequencies) {
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    std::vector<TextChunk> chunks;
+    splitText(text.data(), text.size(), CHUNK_SIZE, &chunks);
+    InputVec input;
+    for (TextChunk &chunk: chunks) {
+        input.push_back({nullptr, &chunk});
+    }
+    WordCountClient client(intern_keys);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, THREADS);
+    waitForJob(job);
+    closeJobHandle(job);
+    double elapsed = seconds(begin);
+
+    for (OutputPair &pair: output) {
+        (*frequencies)[static_cast<OutputWord *>(pair.first)->word] =
+                static_cast<WordFrequency *>(pair.second)->count;
+        delete pair.first;
+        delete pair.second;
+    }
+    return elapsed;
+}
+
+int main(int argc, char **argv) {
+    std::string directory = argc > 1 ? argv[1] : "../testsoldd/TextFiles";
+    int repeat = argc > 2 ? atoi(argv[2]) : 50;
+
+    printf("%-16s %10s %10s %10s %10s\n", "file", "stream", "tokenizer",
+           "interned", "speedup");
+    for (int i = 1; i <= 4; i++) {
+        std::string name = "text_file_" + std::to_string(i) + ".txt";
+        std::ifstream file(directory + "/" + name);
+        if (not file.is_open()) {
+            fprintf(stderr, "can't open %s/%s\n", directory.c_str(), name.c_str());
+            return EXIT_FAILURE;
+        }
+        std::stringstream content;
+        content << file.rdbuf();
+        std::string text;
+        for (int r = 0; r < repeat; r++) {
+            text += content.str();
+        }
+
+        Frequencies expected, actual, interned_actual;
+        double stream = runStream(text, &expected);
+        double tokenizer = runTokenizer(text, false, &actual);
+        double interned = runTokenizer(text, true, &interned_actual);
+        if (expected != actual || expected != interned_actual) {
+            printf("%s: THE CLIENTS DISAGREE\n", name.c_str());
+            return EXIT_FAILURE;
+        }
+        double best = tokenizer < interned ? tokenizer : interned;
+        printf("%-16s %9.1fms %9.1fms %9.1fms %9.1fx\n", name.c_str(),
+               stream * 1e3, tokenizer * 1e3, interned * 1e3, stream / best);
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include "BlockCompressor.h"
+#include <cstdint>
+#include <cstring>
+
+#define MIN_MATCH 4
+#define HASH_BITS 12
+#define MAX_OFFSET 65535
+// like LZ4, the last bytes are always literals and no match starts in the
+// last MATCH_LIMIT bytes, so the decoder's copies never run past the end
+#define LAST_LITERALS 5
+#define MATCH_LIMIT 12
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+static inline uint32_t read32(const char *in) {
+    uint32_t value;
+    memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hashPrefix(uint32_t prefix) {
+    return (prefix * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// writes the part of a length that doesn't fit in its 4 bits of the token
+static char *writeLength(size_t length, char *out) {
+    for (length -= 15; length >= 255; length -= 255) {
+        *out++ = (char) 255;
+    }
+    *out++ = (char) length;
+    return out;
+}
+
+static bool readLength(const char **in, const char *end, size_t *length) {
+    uint8_t byte;
+    do {
+        if (*in >= end) {
+            return false;
+        }
+        byte = (uint8_t) *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static char *writeSequence(const char *literals, size_t literal_size,
+                           size_t offset, size_t match_size, char *out) {
+    char *token = out++;
+    size_t match_code = match_size > 0 ? match_size - MIN_MATCH : 0;
+    *token = (char) (((literal_size < 15 ? literal_size : 15) << 4)
+                     | (match_code < 15 ? match_code : 15));
+    if (literal_size >= 15) {
+        out = writeLength(literal_size, out);
+    }
+    memcpy(out, literals, literal_size);
+    out += literal_size;
+    if (match_size == 0) {
+        return out;
+    }
+    *out++ = (char) (offset & 0xff);
+    *out++ = (char) (offset >> 8);
+    if (match_code >= 15) {
+        out = writeLength(match_code, out);
+    }
+    return out;
+}
+
+// ******************************************************************
+// *********************** compressor functions *********************
+// ******************************************************************
+
+size_t lzCompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t lzCompress(const char *in, size_t size, char *out) {
+    char *start = out;
+    size_t anchor = 0;
+    if (size > MATCH_LIMIT) {
+        uint32_t table[1 << HASH_BITS];
+        memset(table, 0, sizeof(table));
+        size_t position = 1;
+        table[hashPrefix(read32(in))] = 0;
+        while (position < size - MATCH_LIMIT) {
+            uint32_t prefix = read32(in + position);
+            uint32_t hash = hashPrefix(prefix);
+            size_t candidate = table[hash];
+            table[hash] = (uint32_t) position;
+            if (position - candidate > MAX_OFFSET || read32(in + candidate) != prefix) {
+                position++;
+                continue;
+            }
+
+            size_t match = MIN_MATCH;
+            while (position + match < size - LAST_LITERALS
+                   && in[candidate + match] == in[position + match]) {
+                match++;
+            }
+            out = writeSequence(in + anchor, position - anchor,
+                                position - candidate, match, out);
+            position += match;
+            anchor = position;
+        }
+    }
+    out = writeSequence(in + anchor, size - anchor, 0, 0, out);
+    return out - start;
+}
+
+bool lzDecompress(const char *in, size_t size, char *out, size_t raw_size) {
+    const char *end = in + size;
+    char *out_start = out;
+    char *out_end = out + raw_size;
+    while (in < end) {
+        uint8_t token = (uint8_t) *in++;
+        size_t literal_size = token >> 4;
+        if (literal_size == 15 && not readLength(&in, end, &literal_size)) {
+            return false;
+        }
+        if (literal_size > (size_t) (end - in)
+            || literal_size > (size_t) (out_end - out)) {
+            return false;
+        }
+        memcpy(out, in, literal_size);
+        in += literal_size;
+        out += literal_size;
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = (uint8_t) in[0] | ((size_t) (uint8_t) in[1] << 8);
+        in += 2;
+        size_t match_size = token & 15;
+        if (match_size == 15 && not readLength(&in, end, &match_size)) {
+            return false;
+        }
+        match_size += MIN_MATCH;
+        if (offset == 0 || offset > (size_t) (out - out_start)
+            || match_size > (size_t) (out_end - out)) {
+            return false;
+        }
+        // the match may overlap what it writes, copy byte by byte
+        const char *match = out - offset;
+        for (size_t i = 0; i < match_size; i++) {
+            out[i] = match[i];
+        }
+        out += match_size;
+    }
+    return out == out_end;
+}
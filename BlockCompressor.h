@@ -0,0 +1,29 @@
+#ifndef BLOCKCOMPRESSOR_H
+#define BLOCKCOMPRESSOR_H
+
+#include <cstddef>
+
+/*
+    Description: lzCompressBound returns the most bytes lzCompress may write
+    for size bytes of input.
+*/
+size_t lzCompressBound(size_t size);
+
+/*
+    Description: lzCompress compresses in[0, size) into out, which must hold
+    lzCompressBound(size) bytes, and returns the compressed size. The format
+    is that of an LZ4 block: sequences of a token, literals and a 2 byte
+    offset back to a match of at least 4 bytes, found through a hash table
+    of the last position of every 4 byte prefix. It favours speed over
+    ratio, for data that is compressed once and read once.
+*/
+size_t lzCompress(const char *in, size_t size, char *out);
+
+/*
+    Description: lzDecompress decompresses in[0, size), written by
+    lzCompress from raw_size bytes, into out. Returns false if the input is
+    corrupt.
+*/
+bool lzDecompress(const char *in, size_t size, char *out, size_t raw_size);
+
+#endif //BLOCKCOMPRESSOR_H
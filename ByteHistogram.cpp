@@ -0,0 +1,76 @@
+#include "ByteHistogram.h"
+#include <cstring>
+
+// the counters are spread over this many tables, a byte goes to the table
+// of its position modulo SUB_HISTOGRAMS
+#define SUB_HISTOGRAMS 4
+// below this many bytes clearing and summing the tables costs more than
+// they save, the bytes are counted straight into counts
+#define SMALL_INPUT 64
+
+typedef uint32_t SubHistograms[SUB_HISTOGRAMS][HISTOGRAM_BINS];
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+// counts the 8 bytes of word, byte i going to table i % SUB_HISTOGRAMS
+static inline void countWord(uint64_t word, SubHistograms &tables) {
+    tables[0][word & 0xff]++;
+    tables[1][(word >> 8) & 0xff]++;
+    tables[2][(word >> 16) & 0xff]++;
+    tables[3][(word >> 24) & 0xff]++;
+    tables[0][(word >> 32) & 0xff]++;
+    tables[1][(word >> 40) & 0xff]++;
+    tables[2][(word >> 48) & 0xff]++;
+    tables[3][word >> 56]++;
+}
+
+static void countTail(const unsigned char *data, size_t size,
+                      SubHistograms &tables) {
+    for (size_t i = 0; i < size; i++) {
+        tables[i % SUB_HISTOGRAMS][data[i]]++;
+    }
+}
+
+static void sumTables(const SubHistograms &tables,
+                      uint32_t counts[HISTOGRAM_BINS]) {
+    for (int bin = 0; bin < HISTOGRAM_BINS; bin++) {
+        counts[bin] += tables[0][bin] + tables[1][bin]
+                       + tables[2][bin] + tables[3][bin];
+    }
+}
+
+// ******************************************************************
+// *********************** kernel ***********************************
+// ******************************************************************
+
+// counts data 8 bytes at a time into the tables, the rest byte by byte
+static void countWords(const unsigned char *data, size_t size,
+                       SubHistograms &tables) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        countWord(word, tables);
+    }
+    countTail(data + i, size - i, tables);
+}
+
+// ******************************************************************
+// *********************** histogram functions **********************
+// ******************************************************************
+
+void byteHistogram(const unsigned char *data, size_t size,
+                   uint32_t counts[HISTOGRAM_BINS]) {
+    if (size < SMALL_INPUT) {
+        for (size_t i = 0; i < size; i++) {
+            counts[data[i]]++;
+        }
+        return;
+    }
+    SubHistograms tables;
+    memset(tables, 0, sizeof(tables));
+    countWords(data, size, tables);
+    sumTables(tables, counts);
+}
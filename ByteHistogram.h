@@ -0,0 +1,20 @@
+#ifndef BYTEHISTOGRAM_H
+#define BYTEHISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define HISTOGRAM_BINS 256
+
+/*
+    Description: byteHistogram adds the number of times every byte value
+    occurs in data[0, size) to counts. It is the building block for clients
+    whose map counts bytes (see Sample Client/CounterClient): the data is
+    read 8 bytes at a time and its bytes are counted in turn into 4
+    sub-histograms, so consecutive equal bytes don't serialize on one
+    counter; the sub-histograms are added up at the end.
+*/
+void byteHistogram(const unsigned char *data, size_t size,
+                   uint32_t counts[HISTOGRAM_BINS]);
+
+#endif //BYTEHISTOGRAM_H
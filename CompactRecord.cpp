@@ -0,0 +1,77 @@
+#include "CompactRecord.h"
+#include <cstdint>
+#include <cstring>
+
+// the most bytes a size takes as a varint
+#define MAX_VARINT 10
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+// writes size 7 bits per byte, low bits first, the high bit marking that
+// more bytes follow; returns the number of bytes written
+static size_t writeVarint(size_t size, char *out) {
+    size_t written = 0;
+    while (size >= 0x80) {
+        out[written++] = (char) ((size & 0x7f) | 0x80);
+        size >>= 7;
+    }
+    out[written++] = (char) size;
+    return written;
+}
+
+// ******************************************************************
+// *********************** record functions *************************
+// ******************************************************************
+
+CompactRecord compactWriteRecord(Arena *pages, const char *bytes,
+                                 size_t key_size, size_t value_size) {
+    char header[2 * MAX_VARINT];
+    size_t header_size = writeVarint(key_size, header);
+    header_size += writeVarint(value_size, header + header_size);
+
+    char *record = (char *) pages->allocate(header_size + key_size + value_size, 1);
+    memcpy(record, header, header_size);
+    memcpy(record + header_size, bytes, key_size + value_size);
+    return record;
+}
+
+RecordView compactReadRecord(CompactRecord record) {
+    RecordView view;
+    record = compactReadVarint(record, &view.key_size);
+    record = compactReadVarint(record, &view.value_size);
+    view.key = record;
+    view.value = record + view.key_size;
+    return view;
+}
+
+size_t compactAppendRecord(const RecordView &record, std::vector<char> *out) {
+    size_t offset = out->size();
+    compactAppendVarint(record.key_size, out);
+    compactAppendVarint(record.value_size, out);
+    out->insert(out->end(), record.key, record.key + record.key_size);
+    out->insert(out->end(), record.value, record.value + record.value_size);
+    return offset;
+}
+
+void compactAppendVarint(size_t value, std::vector<char> *out) {
+    while (value >= 0x80) {
+        out->push_back((char) ((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back((char) value);
+}
+
+const char *compactReadVarint(const char *in, size_t *value) {
+    size_t result = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = (uint8_t) *in++;
+        result |= (size_t) (byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    *value = result;
+    return in;
+}
@@ -0,0 +1,50 @@
+#ifndef COMPACTRECORD_H
+#define COMPACTRECORD_H
+
+#include "Arena.h"
+#include <cstddef>
+#include <vector>
+
+// an intermediate pair of a CompactMapReduceClient: the key and value
+// sizes as varints followed by the key and value bytes, in a page
+typedef const char *CompactRecord;
+typedef std::vector<CompactRecord> RecordVec;
+
+// the parts of a CompactRecord
+typedef struct RecordView {
+    const char *key;
+    size_t key_size;
+    const char *value;
+    size_t value_size;
+} RecordView;
+
+/*
+    Description: compactWriteRecord copies a key of key_size bytes followed
+    by a value of value_size bytes (both in bytes) into a record allocated
+    from pages and returns it. Records are byte aligned and packed one
+    after the other, so a pair of two ints takes 10 bytes.
+*/
+CompactRecord compactWriteRecord(Arena *pages, const char *bytes,
+                                 size_t key_size, size_t value_size);
+
+/*
+    Description: compactReadRecord returns the key and value of record.
+*/
+RecordView compactReadRecord(CompactRecord record);
+
+/*
+    Description: compactAppendRecord appends record in the format of
+    compactWriteRecord to out and returns the offset it starts at.
+*/
+size_t compactAppendRecord(const RecordView &record, std::vector<char> *out);
+
+/*
+    Description: compactAppendVarint appends value 7 bits per byte, low bits
+    first, the high bit of a byte marking that more follow.
+    compactReadVarint reads one back and returns the byte after it.
+*/
+void compactAppendVarint(size_t value, std::vector<char> *out);
+
+const char *compactReadVarint(const char *in, size_t *value);
+
+#endif //COMPACTRECORD_H
@@ -0,0 +1,115 @@
+#include "CompressedRun.h"
+#include "BlockCompressor.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+// appends a block as its raw size, its stored size (0 when it is stored
+// uncompressed) and its bytes
+static void flushBlock(std::vector<char> *block, std::vector<char> *compressed,
+                       CompressedRun *run) {
+    if (block->empty()) {
+        return;
+    }
+    compressed->resize(lzCompressBound(block->size()));
+    size_t size = lzCompress(block->data(), block->size(), compressed->data());
+    compactAppendVarint(block->size(), &run->bytes);
+    if (size < block->size()) {
+        compactAppendVarint(size, &run->bytes);
+        run->bytes.insert(run->bytes.end(), compressed->begin(),
+                          compressed->begin() + size);
+    } else {
+        compactAppendVarint(0, &run->bytes);
+        run->bytes.insert(run->bytes.end(), block->begin(), block->end());
+    }
+    run->raw_bytes += block->size();
+    block->clear();
+}
+
+// ******************************************************************
+// *********************** run functions ****************************
+// ******************************************************************
+
+void compressRun(const RecordVec &records, CompressedRun *run) {
+    run->bytes.clear();
+    run->records = records.size();
+    run->raw_bytes = 0;
+
+    std::vector<char> block;
+    std::vector<char> compressed;
+    RecordView previous = {nullptr, 0, nullptr, 0};
+    for (CompactRecord record: records) {
+        RecordView view = compactReadRecord(record);
+        size_t shared = 0;
+        if (not block.empty()) {
+            size_t limit = view.key_size < previous.key_size ? view.key_size
+                                                             : previous.key_size;
+            while (shared < limit && view.key[shared] == previous.key[shared]) {
+                shared++;
+            }
+        }
+        compactAppendVarint(shared, &block);
+        compactAppendVarint(view.key_size - shared, &block);
+        compactAppendVarint(view.value_size, &block);
+        block.insert(block.end(), view.key + shared, view.key + view.key_size);
+        block.insert(block.end(), view.value, view.value + view.value_size);
+        previous = view;
+        if (block.size() >= RUN_BLOCK_SIZE) {
+            flushBlock(&block, &compressed, run);
+        }
+    }
+    flushBlock(&block, &compressed, run);
+    run->bytes.shrink_to_fit();
+}
+
+RunReader::RunReader(const CompressedRun &run)
+        : position(run.bytes.data()), end(run.bytes.data() + run.bytes.size()),
+          block_offset(0), value(nullptr), value_size(0), has_record(true) {
+    next();
+}
+
+RecordView RunReader::current() const {
+    return {key.data(), key.size(), value, value_size};
+}
+
+void RunReader::readBlock() {
+    size_t raw_size, stored_size;
+    position = compactReadVarint(position, &raw_size);
+    position = compactReadVarint(position, &stored_size);
+    block.resize(raw_size);
+    if (stored_size == 0) {
+        memcpy(block.data(), position, raw_size);
+        position += raw_size;
+    } else {
+        if (not lzDecompress(position, stored_size, block.data(), raw_size)) {
+            std::cerr << "Error reading a compressed run" << std::endl;
+            exit(1);
+        }
+        position += stored_size;
+    }
+    block_offset = 0;
+    key.clear();
+}
+
+void RunReader::next() {
+    if (block_offset == block.size()) {
+        if (position == end) {
+            has_record = false;
+            return;
+        }
+        readBlock();
+    }
+    size_t shared, unshared;
+    const char *entry = block.data() + block_offset;
+    entry = compactReadVarint(entry, &shared);
+    entry = compactReadVarint(entry, &unshared);
+    entry = compactReadVarint(entry, &value_size);
+    key.resize(shared);
+    key.append(entry, unshared);
+    value = entry + unshared;
+    block_offset = (value + value_size) - block.data();
+}
@@ -0,0 +1,70 @@
+#ifndef COMPRESSEDRUN_H
+#define COMPRESSEDRUN_H
+
+#include "CompactRecord.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// raw bytes of records gathered into one compressed block
+#define RUN_BLOCK_SIZE (64 * 1024)
+
+// a sorted run of compact records, as a sequence of compressed blocks
+typedef struct CompressedRun {
+    std::vector<char> bytes;
+    size_t records;
+    // the size the records took uncompressed (front coded), for statistics
+    size_t raw_bytes;
+} CompressedRun;
+
+/*
+    Description: compressRun writes the sorted records to run. Inside a
+    block every key is stored as the length of the prefix it shares with
+    the previous key and the rest of its bytes; sorted keys share long
+    prefixes (big endian integers that are close only differ in their last
+    bytes), so this is the delta encoding of a sorted run. Each block of
+    about RUN_BLOCK_SIZE bytes is then compressed with lzCompress, or kept
+    as is when that doesn't make it smaller.
+*/
+void compressRun(const RecordVec &records, CompressedRun *run);
+
+/*
+    Description: RunReader reads the records of a CompressedRun in order,
+    decompressing one block at a time.
+*/
+class RunReader {
+public:
+    explicit RunReader(const CompressedRun &run);
+
+    /*
+        Description: valid is false once every record was read.
+    */
+    bool valid() const {
+        return has_record;
+    }
+
+    /*
+        Description: current returns the record the reader is at, it stays
+        valid until next is called.
+    */
+    RecordView current() const;
+
+    /*
+        Description: next moves to the following record.
+    */
+    void next();
+
+private:
+    void readBlock();
+
+    const char *position;
+    const char *end;
+    std::vector<char> block;
+    size_t block_offset;
+    std::string key;
+    const char *value;
+    size_t value_size;
+    bool has_record;
+};
+
+#endif //COMPRESSEDRUN_H
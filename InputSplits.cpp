@@ -0,0 +1,94 @@
+#include "InputSplits.h"
+
+static uint64_t packRange(uint32_t begin, uint32_t end) {
+    return ((uint64_t) begin << 32) | end;
+}
+
+static uint32_t rangeBegin(uint64_t range) {
+    return (uint32_t) (range >> 32);
+}
+
+static uint32_t rangeEnd(uint64_t range) {
+    return (uint32_t) range;
+}
+
+InputSplits::InputSplits(int workers, int begin, int end,
+                         const std::vector<double> *costs)
+        : ranges(workers) {
+    int records = end - begin;
+    double total = 0;
+    if (costs != nullptr) {
+        for (int i = begin; i < end; ++i) {
+            total += (*costs)[i];
+        }
+    }
+    // worker i's share ends where the (i + 1)-th part of the records, or
+    // of their cost, does
+    int share_begin = begin;
+    double cost = 0;
+    for (int i = 0; i < workers; ++i) {
+        int share_end;
+        if (i == workers - 1) {
+            share_end = end;
+        } else if (costs == nullptr || total <= 0) {
+            share_end = begin + (int) ((int64_t) records * (i + 1) / workers);
+        } else {
+            double target = total * (i + 1) / workers;
+            share_end = share_begin;
+            while (share_end < end && cost + (*costs)[share_end] <= target) {
+                cost += (*costs)[share_end];
+                share_end++;
+            }
+        }
+        ranges[i].store(packRange(share_begin, share_end),
+                        std::memory_order_relaxed);
+        share_begin = share_end;
+    }
+}
+
+int InputSplits::next(int worker) {
+    std::atomic<uint64_t> &range = ranges[worker];
+    while (true) {
+        uint64_t current = range.load(std::memory_order_relaxed);
+        while (rangeBegin(current) < rangeEnd(current)) {
+            uint64_t taken = packRange(rangeBegin(current) + 1, rangeEnd(current));
+            if (range.compare_exchange_weak(current, taken,
+                                            std::memory_order_relaxed)) {
+                return (int) rangeBegin(current);
+            }
+        }
+        if (not steal(worker)) {
+            return -1;
+        }
+    }
+}
+
+bool InputSplits::steal(int worker) {
+    while (true) {
+        int victim = -1;
+        uint64_t fullest = 0;
+        uint32_t most = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            uint64_t current = ranges[i].load(std::memory_order_relaxed);
+            uint32_t left = rangeEnd(current) - rangeBegin(current);
+            if (rangeBegin(current) < rangeEnd(current) && left > most) {
+                victim = (int) i;
+                fullest = current;
+                most = left;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+        // a single record left is taken whole
+        uint32_t middle = rangeBegin(fullest) + most / 2;
+        if (ranges[victim].compare_exchange_strong(
+                fullest, packRange(rangeBegin(fullest), middle),
+                std::memory_order_relaxed)) {
+            // worker's own range is empty, no thief picks it until now
+            ranges[worker].store(packRange(middle, rangeEnd(fullest)),
+                                 std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef INPUTSPLITS_H
+#define INPUTSPLITS_H
+
+#include "PaddedArray.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/*
+    Description: InputSplits hands the input records [begin, end) of a map
+    stage to its workers in contiguous ranges. Worker i starts with the i-th
+    of workers consecutive shares, equal in cost when costs (one per input
+    record) are given and in records otherwise, and takes its records from
+    the front, in input order. A worker whose range runs out steals the
+    back half of the range with the most records left, so the tail of the
+    stage stays balanced while every worker maps runs of consecutive
+    records: an input that is sorted gives runs that are nearly sorted, and
+    each worker reads the input sequentially.
+*/
+class InputSplits {
+public:
+    InputSplits(int workers, int begin, int end,
+                const std::vector<double> *costs);
+
+    InputSplits(const InputSplits &) = delete;
+
+    InputSplits &operator=(const InputSplits &) = delete;
+
+    /*
+        Description: next returns the index of the next record for worker
+        to map, or -1 once no range has records left.
+    */
+    int next(int worker);
+
+private:
+    // steals the back half of the fullest range into worker's empty one,
+    // returns false if every range is empty
+    bool steal(int worker);
+
+    // a range as one word: begin in the high half, end in the low half.
+    // The worker takes records by moving begin up, thieves move end down
+    PaddedArray<std::atomic<uint64_t>> ranges;
+};
+
+#endif //INPUTSPLITS_H
@@ -0,0 +1,299 @@
+#include "JobLog.h"
+#include "PaddedArray.h"
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <ctime>
+#include <cerrno>
+#include <atomic>
+#include <iostream>
+
+// ******************************************************************
+// ********************** constants & structs ***********************
+// ******************************************************************
+
+#define LOG_QUEUE_SIZE 4096  // must be a power of two
+#define LOG_WRITE_BUFFER_SIZE (64 * 1024)
+#define LOG_MAX_LINE 160
+#define LOG_FLUSH_INTERVAL_NS 10000000L
+#define SEC_TO_NANO 1000000000L
+
+// a queue cell; seq tells producers/consumer whose turn it is on the cell
+typedef struct LogCell {
+    std::atomic<uint64_t> seq;
+    LogRecord record;
+} LogCell;
+
+// bounded multi-producer single-consumer queue (Vyukov style): producers
+// claim a cell with a CAS on enqueue_pos, the writer thread is the only
+// one advancing dequeue_pos so it needs no atomic RMW.
+typedef struct LogQueue {
+    LogCell cells[LOG_QUEUE_SIZE];
+    alignas(CACHE_LINE) std::atomic<uint64_t> enqueue_pos;
+    alignas(CACHE_LINE) uint64_t dequeue_pos;
+} LogQueue;
+
+// ******************************************************************
+// *********************** global variables *************************
+// ******************************************************************
+
+static LogQueue log_queue;
+static std::atomic<bool> log_enabled(false);
+// producers between seeing the log enabled and publishing their cell;
+// closing waits for them before the last drain and before the cells are
+// reset by the next open
+alignas(CACHE_LINE) static std::atomic<int> active_writers(0);
+// serializes jobLogOpen and jobLogClose
+static pthread_mutex_t open_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::atomic<uint64_t> dropped_records(0);
+static int log_fd = -1;
+static uint64_t log_begin_ns = 0;
+
+static pthread_t writer_thread;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static bool writer_stop = false;
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+static uint64_t nowNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * SEC_TO_NANO + ts.tv_nsec;
+}
+
+static void writeAll(const char *buffer, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(log_fd, buffer, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        buffer += written;
+        size -= written;
+    }
+}
+
+static bool dequeue(LogRecord *record) {
+    LogCell *cell = &log_queue.cells[log_queue.dequeue_pos & (LOG_QUEUE_SIZE - 1)];
+    if (cell->seq.load(std::memory_order_acquire) != log_queue.dequeue_pos + 1) {
+        return false;
+    }
+    *record = cell->record;
+    cell->seq.store(log_queue.dequeue_pos + LOG_QUEUE_SIZE,
+                    std::memory_order_release);
+    log_queue.dequeue_pos++;
+    return true;
+}
+
+static size_t formatRecord(const LogRecord &record, char *out) {
+    uint64_t since_begin = record.timestamp_ns - log_begin_ns;
+    int len = snprintf(out, LOG_MAX_LINE, "[%6llu.%06llu] ",
+                       (unsigned long long) (since_begin / SEC_TO_NANO),
+                       (unsigned long long) (since_begin % SEC_TO_NANO) / 1000);
+    if (len < 0) {
+        return 0;
+    }
+    char *body_out = out + len;
+    size_t body_size = LOG_MAX_LINE - len;
+    long long arg0 = record.arg0, arg1 = record.arg1;
+    int body;
+    switch (record.event) {
+        case LOG_JOB_STARTED:
+            body = snprintf(body_out, body_size,
+                            "job started with %lld threads on %lld input pairs\n",
+                            arg0, arg1);
+            break;
+        case LOG_JOB_FINISHED:
+            body = snprintf(body_out, body_size,
+                            "job finished, %lld output pairs\n", arg0);
+            break;
+        case LOG_STAGE_STARTED:
+            body = snprintf(body_out, body_size, "stage %lld started\n", arg0);
+            break;
+        case LOG_STAGE_FINISHED:
+            body = snprintf(body_out, body_size,
+                            "stage %lld finished after %lld ns\n", arg0, arg1);
+            break;
+        case LOG_THREAD_CREATED:
+            body = snprintf(body_out, body_size,
+                            "thread %d created (stage %lld)\n",
+                            record.thread_id, arg0);
+            break;
+        case LOG_THREAD_TERMINATED:
+            body = snprintf(body_out, body_size,
+                            "thread %d terminated after %lld items\n",
+                            record.thread_id, arg1);
+            break;
+        case LOG_JOB_CANCELLED:
+            body = snprintf(body_out, body_size,
+                            "job cancelled in stage %lld, %lld output pairs\n",
+                            arg0, arg1);
+            break;
+        default:
+            body = snprintf(body_out, body_size, "unknown event %u\n",
+                            record.event);
+    }
+    if (body < 0) {
+        return 0;
+    }
+    len += body;
+    return len < LOG_MAX_LINE ? len : LOG_MAX_LINE - 1;
+}
+
+// formats everything currently in the queue and writes it in batches
+static void drain() {
+    static char buffer[LOG_WRITE_BUFFER_SIZE];
+    size_t used = 0;
+    LogRecord record;
+    while (dequeue(&record)) {
+        if (used + LOG_MAX_LINE > LOG_WRITE_BUFFER_SIZE) {
+            writeAll(buffer, used);
+            used = 0;
+        }
+        used += formatRecord(record, buffer + used);
+    }
+    uint64_t dropped = dropped_records.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        if (used + LOG_MAX_LINE > LOG_WRITE_BUFFER_SIZE) {
+            writeAll(buffer, used);
+            used = 0;
+        }
+        used += snprintf(buffer + used, LOG_MAX_LINE,
+                         "[log] %llu records dropped\n",
+                         (unsigned long long) dropped);
+    }
+    if (used > 0) {
+        writeAll(buffer, used);
+    }
+}
+
+static void *writer_phase(void *) {
+    pthread_mutex_lock(&writer_mutex);
+    while (not writer_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_INTERVAL_NS;
+        if (deadline.tv_nsec >= SEC_TO_NANO) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= SEC_TO_NANO;
+        }
+        pthread_cond_timedwait(&writer_cond, &writer_mutex, &deadline);
+        pthread_mutex_unlock(&writer_mutex);
+        drain();
+        pthread_mutex_lock(&writer_mutex);
+    }
+    pthread_mutex_unlock(&writer_mutex);
+    drain();
+    return nullptr;
+}
+
+// ******************************************************************
+// *********************** Log functions ****************************
+// ******************************************************************
+
+// stops the log once no producer is writing a cell, the open_mutex held
+static void closeLog() {
+    if (not log_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // seq_cst pairs with the producers' increment and re-check: either a
+    // producer sees the log disabled, or it is counted here
+    log_enabled.store(false);
+    while (active_writers.load() != 0) {
+        sched_yield();
+    }
+    pthread_mutex_lock(&writer_mutex);
+    writer_stop = true;
+    pthread_cond_signal(&writer_cond);
+    pthread_mutex_unlock(&writer_mutex);
+    pthread_join(writer_thread, NULL);
+    close(log_fd);
+    log_fd = -1;
+}
+
+bool jobLogOpen(const char *path) {
+    pthread_mutex_lock(&open_mutex);
+    closeLog();
+    log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (log_fd < 0) {
+        pthread_mutex_unlock(&open_mutex);
+        return false;
+    }
+    for (uint64_t i = 0; i < LOG_QUEUE_SIZE; ++i) {
+        log_queue.cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    log_queue.enqueue_pos.store(0, std::memory_order_relaxed);
+    log_queue.dequeue_pos = 0;
+    dropped_records.store(0, std::memory_order_relaxed);
+    log_begin_ns = nowNanos();
+
+    // the wall clock is only formatted once, every record is relative to it
+    char header[LOG_MAX_LINE];
+    time_t current_time = time(nullptr);
+    struct tm time_struct;
+    localtime_r(&current_time, &time_struct);
+    size_t len = strftime(header, sizeof(header),
+                          "MapReduceFramework log opened %d.%m.%Y %X\n",
+                          &time_struct);
+    writeAll(header, len);
+
+    writer_stop = false;
+    if (pthread_create(&writer_thread, NULL, writer_phase, NULL)) {
+        std::cerr << "Error creating thread" << std::endl;
+        exit(1);
+    }
+    log_enabled.store(true);
+    pthread_mutex_unlock(&open_mutex);
+    return true;
+}
+
+void jobLogClose() {
+    pthread_mutex_lock(&open_mutex);
+    closeLog();
+    pthread_mutex_unlock(&open_mutex);
+}
+
+void jobLog(log_event_t event, int thread_id, int64_t arg0, int64_t arg1) {
+    if (not log_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    active_writers.fetch_add(1);
+    if (not log_enabled.load()) {
+        active_writers.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    uint64_t pos = log_queue.enqueue_pos.load(std::memory_order_relaxed);
+    LogCell *cell;
+    while (true) {
+        cell = &log_queue.cells[pos & (LOG_QUEUE_SIZE - 1)];
+        uint64_t seq = cell->seq.load(std::memory_order_acquire);
+        int64_t diff = (int64_t) seq - (int64_t) pos;
+        if (diff == 0) {
+            if (log_queue.enqueue_pos.compare_exchange_weak(
+                    pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // queue is full, never make a worker wait for the log
+            dropped_records.fetch_add(1, std::memory_order_relaxed);
+            active_writers.fetch_sub(1, std::memory_order_release);
+            return;
+        } else {
+            pos = log_queue.enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->record.timestamp_ns = nowNanos();
+    cell->record.event = event;
+    cell->record.thread_id = thread_id;
+    cell->record.arg0 = arg0;
+    cell->record.arg1 = arg1;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    active_writers.fetch_sub(1, std::memory_order_release);
+}
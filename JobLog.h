@@ -0,0 +1,59 @@
+#ifndef JOBLOG_H
+#define JOBLOG_H
+
+#include <cstdint>
+
+/*
+    Description: log_event_t enumerates the events a MapReduce job can record
+    in the job log. Each event carries up to two integer arguments whose
+    meaning depends on the event (see the format table in JobLog.cpp).
+*/
+enum log_event_t {
+    LOG_JOB_STARTED = 0,
+    LOG_JOB_FINISHED,
+    LOG_STAGE_STARTED,
+    LOG_STAGE_FINISHED,
+    LOG_THREAD_CREATED,
+    LOG_THREAD_TERMINATED,
+    LOG_JOB_CANCELLED,
+    LOG_EVENT_COUNT
+};
+
+/*
+    Description: LogRecord is the fixed-size record pushed by worker threads.
+    Records are copied into a bounded lock-free queue and formatted later by
+    the log writer thread, so workers never format text or issue syscalls.
+*/
+typedef struct LogRecord {
+    uint64_t timestamp_ns;
+    uint32_t event;
+    int32_t thread_id;
+    int64_t arg0;
+    int64_t arg1;
+} LogRecord;
+
+/*
+    Description: jobLogOpen opens (appends to) the log file at path and starts
+    the background writer thread. Returns false if the file can't be opened.
+    Any previously opened log is closed first.
+*/
+bool jobLogOpen(const char *path);
+
+/*
+    Description: jobLogClose drains all pending records, stops the writer
+    thread and closes the log file. Does nothing if no log is open. A
+    jobLog call racing with it either reaches the file or is ignored, none
+    is left half written in the queue, so the log can be toggled while jobs
+    run.
+*/
+void jobLogClose();
+
+/*
+    Description: jobLog records a single event. It is safe to call from any
+    thread, never blocks, and is a single relaxed load when logging is off.
+    If the queue is full the record is dropped and counted.
+*/
+void jobLog(log_event_t event, int thread_id, int64_t arg0 = 0,
+            int64_t arg1 = 0);
+
+#endif //JOBLOG_H
@@ -0,0 +1,105 @@
+#include "KeyDictionary.h"
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+// FNV-1a
+uint64_t KeyDictionary::hashKey(const char *data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// returns the segment holding id and sets index to its place in it
+int KeyDictionary::segmentOf(uint32_t id, uint32_t *index) {
+    uint64_t scaled = (uint64_t) id / FIRST_SEGMENT + 1;
+    int segment = 63 - __builtin_clzll(scaled);
+    *index = (uint32_t) (id - (((uint64_t) 1 << segment) - 1) * FIRST_SEGMENT);
+    return segment;
+}
+
+// makes lookup(id) return key, allocating id's segment if it is the first
+// id there; shards race to allocate, the losers free theirs
+void KeyDictionary::publish(uint32_t id, const std::string *key) {
+    uint32_t index;
+    int segment = segmentOf(id, &index);
+    const std::string **entries = segments[segment].load(std::memory_order_acquire);
+    if (entries == nullptr) {
+        const std::string **fresh =
+                new const std::string *[(size_t) FIRST_SEGMENT << segment]();
+        if (segments[segment].compare_exchange_strong(entries, fresh,
+                                                      std::memory_order_acq_rel)) {
+            entries = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+    entries[index] = key;
+}
+
+// ******************************************************************
+// *********************** KeyDictionary functions ******************
+// ******************************************************************
+
+KeyDictionary::KeyDictionary() : shards(DICTIONARY_SHARDS), next_id(0) {
+    for (size_t i = 0; i < shards.size(); i++) {
+        pthread_rwlock_init(&shards[i].lock, NULL);
+    }
+    for (int i = 0; i < MAX_SEGMENTS; i++) {
+        segments[i] = nullptr;
+    }
+}
+
+KeyDictionary::~KeyDictionary() {
+    for (size_t i = 0; i < shards.size(); i++) {
+        pthread_rwlock_destroy(&shards[i].lock);
+    }
+    for (int i = 0; i < MAX_SEGMENTS; i++) {
+        delete[] segments[i].load();
+    }
+}
+
+uint32_t KeyDictionary::intern(const char *data, size_t length) {
+    KeyView key = {data, length, hashKey(data, length)};
+    // the low bits of FNV-1a only mix the bytes' low bits, the map's buckets
+    // get all of them
+    Shard &shard = shards[(key.hash >> 32) % DICTIONARY_SHARDS];
+
+    pthread_rwlock_rdlock(&shard.lock);
+    auto found = shard.ids.find(key);
+    bool known = found != shard.ids.end();
+    uint32_t id = known ? found->second : 0;
+    pthread_rwlock_unlock(&shard.lock);
+    if (known) {
+        return id;
+    }
+
+    // another thread may have added it between the two locks; only a new
+    // key is copied
+    pthread_rwlock_wrlock(&shard.lock);
+    found = shard.ids.find(key);
+    if (found != shard.ids.end()) {
+        id = found->second;
+    } else {
+        shard.strings.emplace_back(data, length);
+        const std::string &string = shard.strings.back();
+        id = next_id.fetch_add(1, std::memory_order_relaxed);
+        shard.ids.emplace(KeyView{string.data(), length, key.hash}, id);
+        publish(id, &string);
+    }
+    pthread_rwlock_unlock(&shard.lock);
+    return id;
+}
+
+const std::string &KeyDictionary::lookup(uint32_t id) const {
+    uint32_t index;
+    int segment = segmentOf(id, &index);
+    return *segments[segment].load(std::memory_order_acquire)[index];
+}
+
+uint32_t KeyDictionary::size() const {
+    return next_id.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#ifndef KEYDICTIONARY_H
+#define KEYDICTIONARY_H
+
+#include "PaddedArray.h"
+#include <pthread.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#define DICTIONARY_SHARDS 64
+// ids [0, FIRST_SEGMENT) are in segment 0, every next segment is twice as
+// large, so MAX_SEGMENTS segments hold every uint32_t id
+#define FIRST_SEGMENT 1024
+#define MAX_SEGMENTS 23
+
+/*
+    Description: KeyDictionary maps every distinct string it is given to a
+    dense id (0, 1, 2, ... in order of first appearance) and back. Any
+    number of threads may intern and look up concurrently: the strings are
+    spread over shards that each have their own read-write lock, so a key
+    that is already known only takes a read lock and is found without
+    copying it, and lookup takes none.
+*/
+class KeyDictionary {
+public:
+    KeyDictionary();
+
+    ~KeyDictionary();
+
+    KeyDictionary(const KeyDictionary &) = delete;
+
+    KeyDictionary &operator=(const KeyDictionary &) = delete;
+
+    /*
+        Description: intern returns the id of data[0, length), adding it to
+        the dictionary if it is new.
+    */
+    uint32_t intern(const char *data, size_t length);
+
+    /*
+        Description: lookup returns the string of an id intern returned. It
+        stays valid as long as the dictionary.
+    */
+    const std::string &lookup(uint32_t id) const;
+
+    /*
+        Description: size returns the number of distinct strings interned.
+    */
+    uint32_t size() const;
+
+private:
+    // bytes the map compares without owning them, with their hash
+    typedef struct KeyView {
+        const char *data;
+        size_t length;
+        uint64_t hash;
+    } KeyView;
+
+    struct KeyViewHash {
+        size_t operator()(const KeyView &key) const {
+            return (size_t) key.hash;
+        }
+    };
+
+    struct KeyViewEqual {
+        bool operator()(const KeyView &key1, const KeyView &key2) const {
+            return key1.length == key2.length
+                   && memcmp(key1.data, key2.data, key1.length) == 0;
+        }
+    };
+
+    typedef struct Shard {
+        pthread_rwlock_t lock;
+        // the keys view the strings, which a deque never moves
+        std::unordered_map<KeyView, uint32_t, KeyViewHash, KeyViewEqual> ids;
+        std::deque<std::string> strings;
+    } Shard;
+
+    static uint64_t hashKey(const char *data, size_t length);
+
+    static int segmentOf(uint32_t id, uint32_t *index);
+
+    void publish(uint32_t id, const std::string *key);
+
+    PaddedArray<Shard> shards;
+    std::atomic<uint32_t> next_id;
+    // id -> string, the strings are the shards'
+    std::atomic<const std::string **> segments[MAX_SEGMENTS];
+};
+
+#endif //KEYDICTIONARY_H
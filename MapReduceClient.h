@@ -1,6 +1,8 @@
 #ifndef MAPREDUCECLIENT_H
 #define MAPREDUCECLIENT_H
 
+#include <cstddef> //size_t
+#include <cstring> //memcmp
 #include <vector>  //std::vector
 #include <utility> //std::pair
 
@@ -58,7 +60,8 @@ typedef std::vector <OutputPair> OutputVec;
 class MapReduceClient {
 public:
     // gets a single pair (K1, V1) and calls emit2(K2,V2, context) any
-    // number of times to output (K2, V2) pairs.
+    // number of times to output (K2, V2) pairs. In a job started by
+    // startMapOnlyJob it calls emit3(K3, V3, context) instead.
     /*
     Signature: map(key, value) -> list(key', value')
     Description: This function takes an input key-value pair and produces a list
@@ -78,6 +81,127 @@ public:
     and produces a list of final key-value pairs as output.
      */
     virtual void reduce(const IntermediateVec *pairs, void *context) const = 0;
+
+    // gets intermediate pairs of a cancelled job that will never reach
+    // reduce, to free them the way reduce would have. The default does
+    // nothing, which suits pairs allocated with emitAlloc (released with
+    // the job).
+    virtual void discard(const IntermediateVec *pairs) const {
+        (void) pairs;
+    }
+
+    // optionally estimates the cost of mapping every record of input (in
+    // any unit, one per record) into costs and returns true. The map
+    // threads then start on contiguous ranges of equal cost instead of
+    // equal record counts. The default has no estimate and returns false.
+    virtual bool estimateMapCosts(const InputVec &input,
+                                  std::vector<double> *costs) const {
+        (void) input;
+        (void) costs;
+        return false;
+    }
+};
+
+
+// a client whose reduce is associative: reducing parts of a group and merging
+// the parts' outputs gives the same result as reducing the whole group. The
+// framework may then split a very large group across several reducers
+// (see JobOptions::split_threshold). A CompactMapReduceClient can be
+// mergeable too, it is then passed to the job as its CompactMapReduceClient.
+class MergeableMapReduceClient : public MapReduceClient {
+public:
+    // gets the (K3, V3) pairs reduce emitted for every part of one split
+    // group and calls emit3(K3, V3, context) to output the final pairs.
+    // The partial pairs are owned by merge, which must free them.
+    virtual void merge(const OutputVec *partials, void *context) const = 0;
+};
+
+
+// a client that can follow another job in a chain (see
+// startMapReduceChain): it also maps the (K3, V3) pairs the reduce of the
+// job before it emits, as they are emitted.
+class ChainedMapReduceClient : public MapReduceClient {
+public:
+    // gets a single (K3, V3) pair of the job before and calls
+    // emit2(K2, V2, context) any number of times. The pair is handed over
+    // as the output vector would hand it: mapOutput frees it, unless the
+    // reduce that emitted it allocated it with emitAlloc.
+    virtual void mapOutput(const K3 *key, const V3 *value,
+                           void *context) const = 0;
+};
+
+
+// a client whose outputs have a rank. With JobOptions::top_k the job
+// outputs only the top_k best ranked pairs, best first, and drops the others
+// as soon as they are emitted.
+class RankedMapReduceClient : public MapReduceClient {
+public:
+    // whether pair1 ranks before (is better than) pair2
+    virtual bool ranksBefore(const OutputPair &pair1,
+                             const OutputPair &pair2) const = 0;
+
+    // frees an output pair that didn't make the top. The default deletes
+    // both, override it for outputs allocated with emitAlloc
+    virtual void dropOutput(K3 *key, V3 *value) const {
+        delete key;
+        delete value;
+    }
+};
+
+
+// a client that aggregates its whole input into a single output pair (see
+// startAggregateJob). Every map thread folds the values its map passes to
+// emitAggregate into an accumulator of its own, and the accumulators are
+// merged when the threads are done; no intermediate pair is emitted and
+// reduce is never called.
+class AggregateMapReduceClient : public MapReduceClient {
+public:
+    // a new accumulator, the aggregate of no values
+    virtual V3 *init() const = 0;
+
+    // folds value into accumulator. value stays the map's
+    virtual void accumulate(V3 *accumulator, const V2 *value) const = 0;
+
+    // folds the accumulator other into accumulator and frees other
+    virtual void merge(V3 *accumulator, V3 *other) const = 0;
+
+    // the key the aggregate is output with, nullptr by default
+    virtual K3 *aggregateKey() const {
+        return nullptr;
+    }
+};
+
+
+// a client whose K2/V2 can be written as bytes. The framework then keeps
+// the intermediate pairs as compact byte records in per-thread pages
+// instead of as objects, and compares keys through lessKey without
+// rebuilding them. emit2 copies the bytes right away, the key and value it
+// is given stay the map's (they can live on its stack). Reduce gets the
+// pairs rebuilt by deserializeKey and deserializeValue.
+class CompactMapReduceClient : public MapReduceClient {
+public:
+    // appends the bytes of key (or value) to out
+    virtual void serializeKey(const K2 *key, std::vector<char> *out) const = 0;
+
+    virtual void serializeValue(const V2 *value, std::vector<char> *out) const = 0;
+
+    // rebuilds a key (or value) from its bytes, typically with
+    // emitAlloc(context, ...) since reduce doesn't delete what it gets.
+    // Every pair of a group gets the same K2.
+    virtual K2 *deserializeKey(const char *data, size_t size,
+                               void *context) const = 0;
+
+    virtual V2 *deserializeValue(const char *data, size_t size,
+                                 void *context) const = 0;
+
+    // the K2 order on serialized keys. The default compares the bytes as
+    // unsigned, a shorter prefix first, which fits keys serialized big
+    // endian (with the sign bit flipped for signed numbers) or as strings.
+    virtual bool lessKey(const char *key1, size_t size1,
+                         const char *key2, size_t size2) const {
+        int order = memcmp(key1, key2, size1 < size2 ? size1 : size2);
+        return order < 0 || (order == 0 && size1 < size2);
+    }
 };
 
 
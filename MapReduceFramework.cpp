@@ -1,44 +1,182 @@
 #include "MapReduceFramework.h"
+#include "JobLog.h"
+#include "Affinity.h"
+#include "PaddedArray.h"
+#include "Arena.h"
+#include "ReduceQueue.h"
+#include "KeyDictionary.h"
+#include "CompactRecord.h"
+#include "CompressedRun.h"
+#include "InputSplits.h"
+#include "NaturalSort.h"
+#include "ParallelSort.h"
 #include <pthread.h>
-#include <semaphore.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include <cstdio>
+#include <cerrno>
+#include <ctime>
 #include <atomic>
 #include <list>
+#include <deque>
 #include <numeric>
 #include <iostream>
 #include <algorithm>
-#include <queue>
 #include <vector>  //std::vector
 #include <utility> //std::pair
 
+#define WARMUP_MAX_RECORDS 64
+#define WARMUP_MAX_NANOS 2000000L
+// a map thread is only worth creating for at least this much work
+#define MIN_NANOS_PER_THREAD 500000L
+// the most intermediate pairs the shuffle may have queued for the reducers
+#define REDUCE_QUEUE_PAIRS (64 * 1024)
+// compress_runs: a map thread compresses its records into a new run every
+// time it holds this many
+#define RUN_SPILL_RECORDS (64 * 1024)
+// a map thread's run of at least this many pairs is sorted with the help of
+// the map threads that are done, in parts of no fewer than SORT_LEAF_PAIRS
+#define PARALLEL_SORT_PAIRS (256 * 1024)
+#define SORT_LEAF_PAIRS (16 * 1024)
+
 // ******************************************************************
 // ********************** typedefs & structs ************************
 
 // ******************************************************************
-typedef std::queue<std::vector<IntermediatePair>> ShuffledQueue_t;
-
+// set by cancelJob, or once the deadline passes; workers poll it between
+// map records, shuffle groups and reduce tasks
+typedef struct Cancellation {
+    std::atomic<bool> requested;
+    // CLOCK_MONOTONIC nanoseconds the job is cancelled at, 0 for none
+    int64_t deadline;
+    // set by whoever saw the request and left work undone because of it;
+    // a job ends cancelled only then, a request that came too late to stop
+    // anything leaves it finished
+    std::atomic<bool> stopped;
+    // the job's stage when the first of them stopped, for the log; read
+    // from the job's state under its mutex
+    stage_t stopped_stage;
+    const JobState *state;
+    pthread_mutex_t *state_mutex;
+} Cancellation;
+
+// per-thread progress counters, each written by one worker only;
+// getJobState adds them up on read
+typedef PaddedArray<std::atomic<int64_t>> ProgressCounters;
+
+// what getJobState computes the current stage's percentage from: base plus
+// the counters done out of total
+typedef struct StageProgress {
+    ProgressCounters *counters;
+    int64_t base;
+    int64_t total;
+} StageProgress;
+
+// aggregate jobs: the accumulator of every map thread and whether the
+// thread has merged its part of the tree into it, under mutex
+typedef struct Aggregation {
+    const AggregateMapReduceClient *client;
+    std::vector<V3 *> accumulators;
+    std::vector<char> merged;
+    pthread_mutex_t mutex;
+    pthread_cond_t merged_cond;
+} Aggregation;
+
+// the map threads of a stage: the large runs with parts left to hand out,
+// and the number of threads still mapping, under mutex. A thread that is
+// done helps sort the runs until no part is left and no thread maps
+typedef struct SortPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    int mapping;
+    std::deque<SortTask *> tasks;
+} SortPool;
+
+// per-thread state: each worker writes only to its own context (and the
+// intermediate vector it points to), both live in a PaddedArray so that
+// no two workers share a cache line.
 typedef struct ThreadContext {
     const MapReduceClient *client;
     const InputVec *input_vec;
     IntermediateVec *intermediate_vec;
-    ShuffledQueue_t *shuffled_queue;
+    ReduceQueue *reduce_queue;
     OutputVec *output_vec;
     pthread_mutex_t *mutex;
     std::atomic<int> *atomicCounter;
     int multiThreadLevel;
     JobState *current_state;
-    std::vector<IntermediateVec> *intermediate_vecs;
-    int key_count;
+    PaddedArray<IntermediateVec> *intermediate_vecs;
+    // the number of groups, final once the reduce queue is closed
+    int *group_count;
+    int thread_id;
+    CpuPlacement placement;
+    int64_t processed_count;
+    // sorted output only: this thread's emit3 buffer, the number of outputs
+    // of every group and the barrier the reducers place their buffers at
+    OutputVec *local_output;
+    std::vector<size_t> *group_sizes;
+    pthread_barrier_t *output_barrier;
+    // the job-owned arena emitAlloc allocates from
+    Arena *arena;
+    // split groups only: the partial output buffer emit3 appends to while
+    // reducing a part
+    OutputVec *partial_output;
+    // the job's key dictionary internKey adds to
+    KeyDictionary *dictionary;
+    // CompactMapReduceClient only: emit2 writes each pair as a record to
+    // record_pages and appends it to records instead of intermediate_vec.
+    // For a reducer record_pages is where the pairs of a group are rebuilt
+    const CompactMapReduceClient *compact;
+    Arena *record_pages;
+    RecordVec *records;
+    // compress_runs only: the runs the records are compressed to
+    std::vector<CompressedRun> *compressed_runs;
+    Cancellation *cancellation;
+    // this thread's progress counter: records mapped, or pairs reduced
+    std::atomic<int64_t> *progress;
+    // chains only: the context a reducer maps its output with for the
+    // next job, emit3 hands it to the next client's mapOutput
+    struct ThreadContext *chained_map;
+    // top_k only: the heap of this reducer's best top_k outputs
+    OutputVec *top_output;
+    size_t top_k;
+    // aggregate jobs only: the accumulator emitAggregate folds into, and
+    // the map threads' tree it is merged in
+    V3 *accumulator;
+    Aggregation *aggregation;
+    // map threads only: the ranges of input records this thread maps from
+    InputSplits *input_splits;
+    // the map stage's threads sharing the sort of large runs, nullptr
+    // when a thread sorts its run alone
+    SortPool *sort_pool;
 } ThreadContext;
 
 typedef struct ShuffleContext {
     pthread_mutex_t *mutex;
     std::atomic<int> *atomicCounter;
     JobState *current_state;
-    std::vector<IntermediateVec> *intermediate_vecs;
-    sem_t *shuffle_sem;
-    ShuffledQueue_t *queue;
+    PaddedArray<IntermediateVec> *intermediate_vecs;
+    ReduceQueue *reduce_queue;
     int multiThreadLevel;
+    std::vector<int> *run_nodes;
+    int local_node;
+    int *group_count;
+    // skew: groups larger than split_threshold (0 for none) are cut into up
+    // to max_parts tasks, splits owns the groups while their parts run
+    size_t split_threshold;
+    int max_parts;
+    std::deque<SplitGroup> *splits;
+    // CompactMapReduceClient only: the runs are record_vecs, ordered by
+    // the client's lessKey
+    PaddedArray<RecordVec> *record_vecs;
+    const CompactMapReduceClient *compact;
+    // compress_runs only: the runs are the compressed runs of every thread
+    PaddedArray<std::vector<CompressedRun>> *compressed_runs;
+    // a cancelled shuffle hands the pairs it didn't merge to client
+    const MapReduceClient *client;
+    Cancellation *cancellation;
+    // the number of pairs merged into groups
+    std::atomic<int64_t> *progress;
 } ShuffleContext;
 
 typedef struct WaitContext {
@@ -46,108 +184,621 @@ typedef struct WaitContext {
     int multiThreadLevel;
 } WaitContext;
 
+// what a job keeps after startMapReduceJob returns, JobHandle points to it
+typedef struct JobContext {
+    // the arguments of startMapReduceChain, run by run_job on thread
+    std::vector<const MapReduceClient *> clients;
+    const InputVec *input_vec;
+    OutputVec *output_vec;
+    int multiThreadLevel;
+    JobOptions options;
+    // startMapOnlyJob: map emits straight to the output, there is nothing
+    // to shuffle or reduce. startAggregateJob's jobs are map-only too
+    bool map_only;
+    const AggregateMapReduceClient *aggregate;
+    pthread_t thread;
+    // set when the job completes, under done_mutex with the ways to
+    // learn about it: done_cond, the callback and the eventfd (-1 until
+    // asked for)
+    pthread_mutex_t done_mutex;
+    pthread_cond_t done_cond;
+    bool done;
+    job_callback_t callback;
+    void *callback_arg;
+    int event_fd;
+    // waitForJob joins thread once, whoever calls it first
+    pthread_mutex_t join_mutex;
+    bool joined;
+    // state is written by the job thread and read by getJobState; while
+    // progress has counters the percentage is computed from them
+    pthread_mutex_t state_mutex;
+    JobState state;
+    StageProgress progress;
+    Cancellation cancellation;
+    // emitAlloc arenas: one for the warm-up records and one per worker
+    Arena warmup_arena;
+    PaddedArray<Arena> *arenas;
+    // InternedKey ids, shared by every thread of the job
+    KeyDictionary dictionary;
+
+    JobContext() : input_vec(nullptr), output_vec(nullptr),
+                   multiThreadLevel(0), map_only(false), aggregate(nullptr),
+                   done(false), callback(nullptr),
+                   callback_arg(nullptr), event_fd(-1), joined(false),
+                   arenas(nullptr) {
+        pthread_mutex_init(&done_mutex, NULL);
+        // timed waits are measured on the monotonic clock
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&done_cond, &attr);
+        pthread_condattr_destroy(&attr);
+        pthread_mutex_init(&join_mutex, NULL);
+        pthread_mutex_init(&state_mutex, NULL);
+        state.stage = UNDEFINED_STAGE;
+        state.percentage = 0.0;
+        progress = {nullptr, 0, 0};
+        cancellation.requested = false;
+        cancellation.deadline = 0;
+        cancellation.stopped = false;
+        cancellation.stopped_stage = UNDEFINED_STAGE;
+        cancellation.state = &state;
+        cancellation.state_mutex = &state_mutex;
+    }
+
+    ~JobContext() {
+        delete arenas;
+        if (event_fd >= 0) {
+            close(event_fd);
+        }
+        pthread_mutex_destroy(&done_mutex);
+        pthread_cond_destroy(&done_cond);
+        pthread_mutex_destroy(&join_mutex);
+        pthread_mutex_destroy(&state_mutex);
+    }
+} JobContext;
+
 // ******************************************************************
 // *********************** helper functions *************************
 // ******************************************************************
 
-JobState current_state;
+int64_t elapsedNanos(const struct timespec &begin) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (int64_t) (end.tv_sec - begin.tv_sec) * 1000000000L
+           + (end.tv_nsec - begin.tv_nsec);
+}
+
+int64_t monotonicNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+// whether the job was cancelled; a passed deadline cancels it here. Only a
+// job with a deadline reads the clock. Callers skip or drop work when it
+// returns true, so that marks the job stopped, in the stage it is in then
+bool jobCancelled(Cancellation *cancellation) {
+    if (not cancellation->requested.load(std::memory_order_relaxed)) {
+        if (cancellation->deadline == 0
+            || monotonicNanos() < cancellation->deadline) {
+            return false;
+        }
+        cancellation->requested.store(true, std::memory_order_relaxed);
+    }
+    if (not cancellation->stopped.load(std::memory_order_relaxed)
+        && not cancellation->stopped.exchange(true)) {
+        pthread_mutex_lock(cancellation->state_mutex);
+        cancellation->stopped_stage = cancellation->state->stage;
+        pthread_mutex_unlock(cancellation->state_mutex);
+    }
+    return true;
+}
+
+float progressPercentage(const StageProgress &progress) {
+    if (progress.total <= 0) {
+        return 100;
+    }
+    int64_t done = progress.base;
+    for (size_t i = 0; i < progress.counters->size(); i++) {
+        done += (*progress.counters)[i].load(std::memory_order_relaxed);
+    }
+    return done < progress.total ? 100.0f * done / progress.total : 100;
+}
+
+// moves the job to stage, whose percentage getJobState computes from
+// progress (or keeps where the last stage left it without counters). The
+// counters of the last stage aren't read after this returns
+void setJobStage(JobContext *job, stage_t stage,
+                 StageProgress progress = {nullptr, 0, 0}) {
+    pthread_mutex_lock(&job->state_mutex);
+    if (job->progress.counters != nullptr) {
+        job->state.percentage = progressPercentage(job->progress);
+    }
+    job->state.stage = stage;
+    job->progress = progress;
+    pthread_mutex_unlock(&job->state_mutex);
+}
 
 bool comparePairs(const std::pair<K2 *, V2 *> &pair1,
                   const std::pair<K2 *, V2 *> &pair2) {
     return *pair1.first < *pair2.first;
 }
 
+// orders the records of a CompactMapReduceClient by their keys
+typedef struct RecordLess {
+    const CompactMapReduceClient *client;
+
+    bool operator()(CompactRecord record1, CompactRecord record2) const {
+        RecordView view1 = compactReadRecord(record1);
+        RecordView view2 = compactReadRecord(record2);
+        return client->lessKey(view1.key, view1.key_size,
+                               view2.key, view2.key_size);
+    }
+} RecordLess;
+
+// orders the outputs of a RankedMapReduceClient best first
+typedef struct RankLess {
+    const RankedMapReduceClient *client;
+
+    bool operator()(const OutputPair &pair1, const OutputPair &pair2) const {
+        return client->ranksBefore(pair1, pair2);
+    }
+} RankLess;
+
 bool operatorEqual(const std::pair<K2 *, V2 *> &pair1,
                    const std::pair<K2 *, V2 *> &pair2) {
     return (not comparePairs(pair1, pair2)) and (not comparePairs(pair2, pair1));
 }
 
-int min_key_ind(std::pair<K2 *, V2 *> *min_list, std::list<int> ind_list) {
-    auto min1 = min_list[0];
-    int min_ind = 0;
-    for (auto i: ind_list) {
-        if (comparePairs(min1, min_list[i])) {
-            min1 = min_list[i];
-            min_ind = i;
+void joinThreads(WaitContext *wait) {
+    for (int i = 0; i < wait->multiThreadLevel; i++) {
+        pthread_join((*wait->threads)[i], NULL);
+    }
+}
+
+void createThread(pthread_t *thread, void *(*phase)(void *), void *context,
+                  const CpuPlacement &placement) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    affinityApply(&attr, placement);
+    if (pthread_create(thread, &attr, phase, context)) {
+        std::cerr << "Error creating thread" << std::endl;
+        exit(1);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+// maps the first records on the calling thread with warmup_context (whose
+// emit2 buffers are handed to thread 0 afterwards) to measure the cost of
+// a record, returns the number of records it mapped
+int warmUp(const MapReduceClient &client, const InputVec &inputVec,
+           ThreadContext *warmup_context, int64_t *nanos_per_record) {
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    int mapped = 0;
+    int64_t elapsed = 0;
+    while (mapped < (int) inputVec.size() && mapped < WARMUP_MAX_RECORDS
+           && elapsed < WARMUP_MAX_NANOS) {
+        client.map(inputVec[mapped].first, inputVec[mapped].second,
+                   (void *) warmup_context);
+        mapped++;
+        elapsed = elapsedNanos(begin);
+    }
+    *nanos_per_record = mapped > 0 ? elapsed / mapped : 0;
+    return mapped;
+}
+
+// picks the number of map threads; auto mode (multiThreadLevel <= 0) uses
+// every cpu unless the remaining work is too small to keep them all busy
+int chooseThreadCount(int multiThreadLevel, int max_threads, int records,
+                      int64_t nanos_per_record) {
+    int threads = multiThreadLevel;
+    if (multiThreadLevel <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int) cpus : 1;
+        int64_t worth = (int64_t) records * nanos_per_record / MIN_NANOS_PER_THREAD;
+        if (worth < threads) {
+            threads = (int) worth;
         }
     }
-    return min_ind;
+    if (threads > records) {
+        threads = records;
+    }
+    if (max_threads > 0 && threads > max_threads) {
+        threads = max_threads;
+    }
+    return threads > 0 ? threads : 1;
 }
 
 // ******************************************************************
 // *********************** map phase function ***********************
 // ******************************************************************
 
+// compress_runs: sorts the records emitted since the last spill into a new
+// compressed run and rewinds the pages they were written to
+void spill_records(ThreadContext *t_context) {
+    if (t_context->records->empty()) {
+        return;
+    }
+    naturalSort(t_context->records->begin(), t_context->records->end(),
+                RecordLess{t_context->compact});
+    t_context->compressed_runs->emplace_back();
+    compressRun(*t_context->records, &t_context->compressed_runs->back());
+    t_context->records->clear();
+    t_context->record_pages->reset();
+}
+
+void sort_run(ThreadContext *t_context);
+
+void merge_accumulators(ThreadContext *t_context);
+
+void share_sort(ThreadContext *t_context);
+
 void *map_phase(void *context) {
     ThreadContext *t_context = (ThreadContext *) context;
     int input_size = t_context->input_vec->size();
-    std::atomic<int> processed_count(0);
-    int progress_percentage = (int) (100 * processed_count / input_size);
+    jobLog(LOG_THREAD_CREATED, t_context->thread_id, MAP_STAGE);
+    if (t_context->placement.cpu >= 0) {
+        // pinned: allocate the emit2 buffer here so it is first touched
+        // on this worker's node rather than grown from the main thread's
+        size_t expected = input_size / t_context->multiThreadLevel + 1;
+        if (t_context->compact != nullptr) {
+            t_context->records->reserve(expected);
+        } else if (t_context->intermediate_vec != nullptr) {
+            t_context->intermediate_vec->reserve(expected);
+        }
+    }
 
+    // the input vector is only read and emit2 only writes to this thread's
+    // own vector, so map runs without taking the job mutex. A request is
+    // only polled while records are left, once they are all mapped it has
+    // nothing to stop
     while (true) {
-        pthread_mutex_lock(t_context->mutex);
-        int currentIndex = t_context->atomicCounter->fetch_add(1);
-        if (currentIndex >= (int) t_context->input_vec->size()) {
-            pthread_mutex_unlock(t_context->mutex);
+        int currentIndex = t_context->input_splits->next(t_context->thread_id);
+        if (currentIndex < 0 || jobCancelled(t_context->cancellation)) {
             break;
         }
-        pthread_mutex_unlock(t_context->mutex);
 
-        InputPair pair = (t_context->input_vec)->at(currentIndex);
-        // TODO: CHECK IF NEED TO lock the mutex because use the input vector
-        pthread_mutex_lock(t_context->mutex);
+        const InputPair &pair = (*t_context->input_vec)[currentIndex];
         t_context->client->map(pair.first, pair.second, (void *) t_context);
-        pthread_mutex_unlock(t_context->mutex);
-
+        t_context->processed_count++;
+        t_context->progress->store(t_context->processed_count,
+                                   std::memory_order_relaxed);
     }
-    pthread_mutex_lock(t_context->mutex);
-    std::sort(t_context->intermediate_vec->begin(),
-              t_context->intermediate_vec->end(),
-              comparePairs);
-    pthread_mutex_unlock(t_context->mutex);
+    if (t_context->sort_pool != nullptr) {
+        share_sort(t_context);
+    } else {
+        sort_run(t_context);
+    }
+    if (t_context->aggregation != nullptr) {
+        merge_accumulators(t_context);
+    }
+    jobLog(LOG_THREAD_TERMINATED, t_context->thread_id, MAP_STAGE,
+           t_context->processed_count);
     return nullptr;
 }
 
+// the end of a map thread: sorts its run for the shuffle, or compresses
+// the rest of it. The runs of consecutive input records a thread maps are
+// often in order already, naturalSort merges them instead of sorting anew
+void sort_run(ThreadContext *t_context) {
+    if (t_context->intermediate_vec == nullptr) {
+        // map-only: the output is kept in the order it was emitted
+    } else if (jobCancelled(t_context->cancellation)) {
+        // the job thread drops the unsorted run
+    } else if (t_context->compressed_runs != nullptr) {
+        // only the compressed runs are kept, the pages go right away
+        spill_records(t_context);
+        RecordVec().swap(*t_context->records);
+        t_context->record_pages->release();
+    } else if (t_context->compact != nullptr) {
+        naturalSort(t_context->records->begin(), t_context->records->end(),
+                    RecordLess{t_context->compact});
+    } else {
+        naturalSort(t_context->intermediate_vec->begin(),
+                    t_context->intermediate_vec->end(),
+                    comparePairs);
+    }
+}
+
+// a sort task for the run of a map thread of a stage with threads threads,
+// nullptr for a run small enough to sort alone
+SortTask *run_sort_task(ThreadContext *t_context, int threads) {
+    if (t_context->compressed_runs != nullptr
+        || t_context->intermediate_vec == nullptr) {
+        return nullptr;
+    }
+    size_t size = t_context->compact != nullptr
+                  ? t_context->records->size()
+                  : t_context->intermediate_vec->size();
+    if (size < PARALLEL_SORT_PAIRS) {
+        return nullptr;
+    }
+    int leaves = (int) std::min<size_t>(2 * threads, size / SORT_LEAF_PAIRS);
+    if (t_context->compact != nullptr) {
+        return new RangeSortTask<RecordVec::iterator, RecordLess>(
+                t_context->records->begin(), size, leaves,
+                RecordLess{t_context->compact});
+    }
+    return new RangeSortTask<IntermediateVec::iterator, bool (*)(
+            const IntermediatePair &, const IntermediatePair &)>(
+            t_context->intermediate_vec->begin(), size, leaves, comparePairs);
+}
+
+// the end of a map thread of a stage: a run too large to sort alone is
+// handed to the pool as a task, a smaller one is sorted here. Then the
+// thread runs parts of the pool's tasks until every thread is done mapping
+// and no part is left, the thread that merges a task's root deletes it
+void share_sort(ThreadContext *t_context) {
+    SortPool *pool = t_context->sort_pool;
+    SortTask *task = jobCancelled(t_context->cancellation)
+                     ? nullptr
+                     : run_sort_task(t_context, t_context->multiThreadLevel);
+    pthread_mutex_lock(&pool->mutex);
+    pool->mapping--;
+    if (task != nullptr) {
+        pool->tasks.push_back(task);
+    }
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->mutex);
+    if (task == nullptr) {
+        sort_run(t_context);
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    while (true) {
+        if (not pool->tasks.empty()) {
+            SortTask *shared = pool->tasks.front();
+            int leaf = shared->next_leaf++;
+            if (shared->next_leaf == shared->leaves) {
+                pool->tasks.pop_front();
+            }
+            pthread_mutex_unlock(&pool->mutex);
+            // a cancelled job drops the runs, the parts are only counted
+            if (shared->runLeaf(leaf, jobCancelled(t_context->cancellation))) {
+                delete shared;
+            }
+            pthread_mutex_lock(&pool->mutex);
+        } else if (pool->mapping == 0) {
+            break;
+        } else {
+            pthread_cond_wait(&pool->changed, &pool->mutex);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// aggregate jobs: the end of a map thread. Thread i merges the accumulator
+// of thread i + step into its own for step = 1, 2, 4, ... as long as i is
+// a multiple of 2 * step, waiting for that thread to merge its own part
+// first, then marks its part merged. Thread 0 ends with the aggregate
+void merge_accumulators(ThreadContext *t_context) {
+    Aggregation *aggregation = t_context->aggregation;
+    int i = t_context->thread_id;
+    int threads = t_context->multiThreadLevel;
+    for (int step = 1; i % (2 * step) == 0 && i + step < threads; step *= 2) {
+        pthread_mutex_lock(&aggregation->mutex);
+        while (not aggregation->merged[i + step]) {
+            pthread_cond_wait(&aggregation->merged_cond, &aggregation->mutex);
+        }
+        V3 *other = aggregation->accumulators[i + step];
+        aggregation->accumulators[i + step] = nullptr;
+        pthread_mutex_unlock(&aggregation->mutex);
+        aggregation->client->merge(t_context->accumulator, other);
+    }
+    pthread_mutex_lock(&aggregation->mutex);
+    aggregation->merged[i] = true;
+    pthread_cond_broadcast(&aggregation->merged_cond);
+    pthread_mutex_unlock(&aggregation->mutex);
+}
+
 
 // ******************************************************************
 // *********************** shuffle phase function *******************
 // ******************************************************************
 
-void* shuffle_phase(void* context_t) {
-    ShuffleContext context= *((ShuffleContext*) context_t);
+// the vector of a task or split group that holds a group of this type
+template<typename Holder>
+IntermediateVec &groupRun(Holder &holder, const IntermediateVec &) {
+    return holder.pairs;
+}
 
-    // create list [0...multiThreadLevel]
-    std::list<int> available_ind(context.multiThreadLevel);
-    std::iota(available_ind.begin(), available_ind.end(), 0);
+template<typename Holder>
+RecordVec &groupRun(Holder &holder, const RecordVec &) {
+    return holder.records;
+}
 
+// numbers a finalized group and hands it to the reducers, blocking while
+// the reduce queue is full; a group larger than split_threshold goes out as
+// several parts. Records read from a compressed run come with the bytes
+// they point into
+template<typename Run>
+void push_group(ShuffleContext &context, Run &vec,
+                std::vector<char> *record_bytes = nullptr) {
+    int group = (*context.group_count)++;
+    size_t size = vec.size();
+    context.progress->store(context.progress->load(std::memory_order_relaxed)
+                            + size, std::memory_order_relaxed);
+    size_t parts = 1;
+    if (context.split_threshold > 0 && size > context.split_threshold) {
+        parts = std::min((size + context.split_threshold - 1) / context.split_threshold,
+                         (size_t) context.max_parts);
+    }
+    if (parts < 2) {
+        ReduceTask task = {group, IntermediateVec(), RecordVec(),
+                           std::vector<char>(), nullptr, 0, size, 0};
+        groupRun(task, vec).swap(vec);
+        if (record_bytes != nullptr) {
+            task.record_bytes.swap(*record_bytes);
+        }
+        context.reduce_queue->push(task);
+        return;
+    }
 
-    std::pair<K2 *, V2 *> minlist[context.multiThreadLevel];
-    int min_lists_ind[context.multiThreadLevel];
+    // deque::emplace_back keeps the groups the reducers already hold valid
+    context.splits->emplace_back();
+    SplitGroup &split = context.splits->back();
+    split.group = group;
+    groupRun(split, vec).swap(vec);
+    if (record_bytes != nullptr) {
+        split.record_bytes.swap(*record_bytes);
+    }
+    split.parts_left = (int) parts;
+    split.partials.resize(parts);
+    for (size_t part = 0; part < parts; part++) {
+        ReduceTask task = {group, IntermediateVec(), RecordVec(),
+                           std::vector<char>(), &split, size * part / parts,
+                           size * (part + 1) / parts, (int) part};
+        context.reduce_queue->push(task);
+    }
+}
+
+// the runs that aren't empty, given the node every run lives on. Runs of
+// the shuffle thread's own node go first, so among equal keys the merge
+// picks and drains node-local memory before remote memory
+std::list<int> merge_order(const ShuffleContext &context,
+                           const std::vector<bool> &empty,
+                           const std::vector<int> &nodes) {
+    std::list<int> available_ind;
+    for (int i = 0; i < (int) empty.size(); i++) {
+        if (not empty[i] && nodes[i] == context.local_node) {
+            available_ind.push_back(i);
+        }
+    }
+    for (int i = 0; i < (int) empty.size(); i++) {
+        if (not empty[i] && nodes[i] != context.local_node) {
+            available_ind.push_back(i);
+        }
+    }
+    return available_ind;
+}
+
+// a cancelled shuffle drops what is left of a run; pairs go to the
+// client's discard, records are freed with the job's pages
+void discard_rest(ShuffleContext &context, IntermediateVec &run, size_t pos) {
+    IntermediateVec rest(run.begin() + pos, run.end());
+    context.client->discard(&rest);
+}
+
+void discard_rest(ShuffleContext &, RecordVec &, size_t) {}
+
+// merges the sorted runs (of pairs, or of records) into groups of equal
+// keys and pushes every group as soon as it is complete
+template<typename Run, typename Less>
+void merge_runs(ShuffleContext &context, PaddedArray<Run> &runs, Less less) {
+    std::vector<bool> empty(context.multiThreadLevel);
     for (int i = 0; i < context.multiThreadLevel; i++) {
-        minlist[i] = context.intermediate_vecs->at(i)[0];
-        min_lists_ind[i] = 0;
+        empty[i] = runs[i].empty();
     }
-    auto first_ind = min_key_ind(minlist, available_ind);
-    auto last = context.intermediate_vecs->at(first_ind).at(
-            min_lists_ind[first_ind]);
-    IntermediateVec* vec = new IntermediateVec;
+    std::list<int> available_ind = merge_order(context, empty,
+                                               *context.run_nodes);
+
+    std::vector<size_t> min_lists_ind(context.multiThreadLevel, 0);
     while (not available_ind.empty()) {
-        // get the thread which we will take the pair from, and the pair
-        int min_ind = min_key_ind(minlist, available_ind);
-        auto pair = context.intermediate_vecs->at(min_ind).at(
-                min_lists_ind[min_ind]);
-        if (not operatorEqual(last, pair)) {
-            context.queue->push(*vec);
+        if (jobCancelled(context.cancellation)) {
+            for (int i: available_ind) {
+                discard_rest(context, runs[i], min_lists_ind[i]);
+            }
+            return;
+        }
+        // get the thread which holds the smallest key
+        int min_ind = available_ind.front();
+        for (int i: available_ind) {
+            if (less(runs[i][min_lists_ind[i]],
+                     runs[min_ind][min_lists_ind[min_ind]])) {
+                min_ind = i;
+            }
         }
-        vec = new IntermediateVec;
+        typename Run::value_type last = runs[min_ind][min_lists_ind[min_ind]];
+
+        // collect every pair equal to it, the runs are sorted so they are
+        // all at the heads of the runs
+        Run vec;
+        for (auto it = available_ind.begin(); it != available_ind.end();) {
+            Run &run = runs[*it];
+            size_t &pos = min_lists_ind[*it];
+            while (pos < run.size() && not less(last, run[pos])) {
+                vec.push_back(run[pos++]);
+            }
+            if (pos == run.size()) {
+                it = available_ind.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        push_group(context, vec);
+    }
+}
 
-        last = pair;
-        if (++min_lists_ind[min_ind] == context.intermediate_vecs[min_ind].size()) {
-            available_ind.remove(min_ind);
+// merge_runs for compressed runs: the runs of every thread are read
+// through RunReaders, and the records of a group are copied out of the
+// readers' blocks into bytes the group owns
+void merge_compressed_runs(ShuffleContext &context) {
+    const CompactMapReduceClient *client = context.compact;
+    std::vector<RunReader> readers;
+    std::vector<bool> empty;
+    std::vector<int> nodes;
+    for (int i = 0; i < context.multiThreadLevel; i++) {
+        for (const CompressedRun &run: (*context.compressed_runs)[i]) {
+            readers.emplace_back(run);
+            empty.push_back(not readers.back().valid());
+            nodes.push_back((*context.run_nodes)[i]);
+        }
+    }
+    std::list<int> available_ind = merge_order(context, empty, nodes);
+
+    while (not available_ind.empty() && not jobCancelled(context.cancellation)) {
+        int min_ind = available_ind.front();
+        for (int i: available_ind) {
+            RecordView view = readers[i].current();
+            RecordView min_view = readers[min_ind].current();
+            if (client->lessKey(view.key, view.key_size,
+                                min_view.key, min_view.key_size)) {
+                min_ind = i;
+            }
+        }
+        RecordView min_view = readers[min_ind].current();
+        std::string last(min_view.key, min_view.key_size);
+
+        std::vector<char> bytes;
+        std::vector<size_t> offsets;
+        for (auto it = available_ind.begin(); it != available_ind.end();) {
+            RunReader &reader = readers[*it];
+            while (reader.valid()) {
+                RecordView view = reader.current();
+                if (client->lessKey(last.data(), last.size(),
+                                    view.key, view.key_size)) {
+                    break;
+                }
+                offsets.push_back(compactAppendRecord(view, &bytes));
+                reader.next();
+            }
+            if (not reader.valid()) {
+                it = available_ind.erase(it);
+            } else {
+                ++it;
+            }
         }
+        RecordVec vec(offsets.size());
+        for (size_t i = 0; i < offsets.size(); i++) {
+            vec[i] = bytes.data() + offsets[i];
+        }
+        push_group(context, vec, &bytes);
+    }
+}
+
+void* shuffle_phase(void* context_t) {
+    ShuffleContext context= *((ShuffleContext*) context_t);
+    if (context.compressed_runs != nullptr) {
+        merge_compressed_runs(context);
+    } else if (context.compact != nullptr) {
+        merge_runs(context, *context.record_vecs, RecordLess{context.compact});
+    } else {
+        merge_runs(context, *context.intermediate_vecs, comparePairs);
     }
-//     Signal that we're done
-    sem_post(context.shuffle_sem);
+    // the group count is final, let the reducers drain the queue and stop
+    context.reduce_queue->close();
     return nullptr;
 }
 
@@ -156,27 +807,157 @@ void* shuffle_phase(void* context_t) {
 // *********************** reduce phase function ********************
 // ******************************************************************
 
+// copies this reducer's buffered outputs to their group's place in the
+// output vector. Every reducer waits for the others to count their groups,
+// one of them turns the counts into offsets, then all copy in parallel.
+void place_sorted_output(ThreadContext *t_context,
+                         const std::vector<std::pair<int, size_t>> &groups) {
+    std::vector<size_t> &group_sizes = *t_context->group_sizes;
+    if (pthread_barrier_wait(t_context->output_barrier)
+        == PTHREAD_BARRIER_SERIAL_THREAD) {
+        group_sizes.resize(*t_context->group_count);
+        size_t offset = t_context->output_vec->size();
+        for (size_t &size: group_sizes) {
+            size_t group_size = size;
+            size = offset;
+            offset += group_size;
+        }
+        t_context->output_vec->resize(offset);
+    }
+    pthread_barrier_wait(t_context->output_barrier);
+
+    OutputVec &local_output = *t_context->local_output;
+    for (size_t i = 0; i < groups.size(); i++) {
+        size_t end = i + 1 < groups.size() ? groups[i + 1].second
+                                           : local_output.size();
+        std::copy(local_output.begin() + groups[i].second,
+                  local_output.begin() + end,
+                  t_context->output_vec->begin() + group_sizes[groups[i].first]);
+    }
+}
+
+// for sorted output, records where the outputs of a reduced group start in
+// this thread's buffer and how many there are
+void finish_group(ThreadContext *t_context, int group, size_t start,
+                  std::vector<std::pair<int, size_t>> &groups) {
+    if (t_context->group_sizes == nullptr) {
+        return;
+    }
+    groups.emplace_back(group, start);
+    (*t_context->group_sizes)[group] = t_context->local_output->size() - start;
+}
+
+// rebuilds records [begin, end) of a group as pairs for reduce, every pair
+// shares the key of the first record. The pairs are only needed while
+// reduce runs, so emitAlloc puts them in the thread's group arena, which
+// is reset after every group, rather than in the job's arena
+void deserialize_group(ThreadContext *t_context, const RecordVec &records,
+                       size_t begin, size_t end, IntermediateVec *pairs) {
+    const CompactMapReduceClient *client = t_context->compact;
+    Arena *job_arena = t_context->arena;
+    t_context->arena = t_context->record_pages;
+    RecordView first = compactReadRecord(records[begin]);
+    K2 *key = client->deserializeKey(first.key, first.key_size, t_context);
+    pairs->reserve(end - begin);
+    for (size_t i = begin; i < end; i++) {
+        RecordView view = compactReadRecord(records[i]);
+        pairs->emplace_back(key, client->deserializeValue(view.value,
+                                                          view.value_size,
+                                                          t_context));
+    }
+    t_context->arena = job_arena;
+}
+
+// reduces a whole group, or one part of a split group; the thread that
+// reduces the last part of a group frees its pairs and merges all the
+// parts' outputs
+void reduce_task(ThreadContext *t_context, ReduceTask &task,
+                 std::vector<std::pair<int, size_t>> &groups) {
+    size_t start = t_context->local_output != nullptr
+                   ? t_context->local_output->size() : 0;
+    if (task.split == nullptr) {
+        if (not task.records.empty()) {
+            deserialize_group(t_context, task.records, 0, task.records.size(),
+                              &task.pairs);
+        }
+        t_context->client->reduce(&task.pairs, (void *) t_context);
+        finish_group(t_context, task.group, start, groups);
+        return;
+    }
+
+    SplitGroup &split = *task.split;
+    IntermediateVec pairs;
+    if (split.records.empty()) {
+        pairs.assign(split.pairs.begin() + task.begin,
+                     split.pairs.begin() + task.end);
+    } else {
+        deserialize_group(t_context, split.records, task.begin, task.end, &pairs);
+    }
+    t_context->partial_output = &split.partials[task.part];
+    t_context->client->reduce(&pairs, (void *) t_context);
+    t_context->partial_output = nullptr;
+    if (split.parts_left.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    IntermediateVec().swap(split.pairs);
+    RecordVec().swap(split.records);
+    std::vector<char>().swap(split.record_bytes);
+    OutputVec partials;
+    for (OutputVec &partial: split.partials) {
+        partials.insert(partials.end(), partial.begin(), partial.end());
+    }
+    // a cross cast: the client may also be a CompactMapReduceClient, whose
+    // MapReduceClient base t_context->client then points to
+    dynamic_cast<const MergeableMapReduceClient *>(t_context->client)->merge(
+            &partials, (void *) t_context);
+    finish_group(t_context, task.group, start, groups);
+}
+
 void *reduce_phase(void *context) {
     ThreadContext *t_context = (ThreadContext *) context;
-    int input_size = t_context->input_vec->size();
-    std::atomic<int> processed_count(0);
-    int progress_percentage = (int) (100 * processed_count / input_size);
+    jobLog(LOG_THREAD_CREATED, t_context->thread_id, REDUCE_STAGE);
+
+    // sorted output: emit3 appends here and every group remembers where
+    // its outputs start
+    OutputVec local_output;
+    std::vector<std::pair<int, size_t>> groups;
+    bool sorted = t_context->group_sizes != nullptr;
+    if (sorted) {
+        t_context->local_output = &local_output;
+    }
 
-    while (true) {
-        pthread_mutex_lock(t_context->mutex);
-        int currentIndex = t_context->atomicCounter->fetch_add(1);
-        if (currentIndex >= (int) t_context->key_count) {
-            pthread_mutex_unlock(t_context->mutex);
-            break;
+    // groups arrive while the shuffle is still merging; each task owns its
+    // pairs, which are freed as soon as the next task replaces them. The
+    // client's reduce runs unlocked and emit3 takes the mutex for its own
+    // append
+    Arena group_arena;
+    t_context->record_pages = &group_arena;
+    ReduceTask task;
+    while (t_context->reduce_queue->pop(&task)) {
+        // once cancelled the queue is only drained; the parts of a split
+        // group were queued together and are reduced to finish the group
+        if (task.split == nullptr && jobCancelled(t_context->cancellation)) {
+            if (not task.pairs.empty()) {
+                t_context->client->discard(&task.pairs);
+            }
+            continue;
         }
-        pthread_mutex_unlock(t_context->mutex);
-        // TODO: CHECK IF NEED TO lock the mutex because use the input vector
-        pthread_mutex_lock(t_context->mutex);
-        const IntermediateVec vec=t_context->shuffled_queue->front();
-        t_context->shuffled_queue->pop();
-        t_context->client->reduce(&vec,context);
-        pthread_mutex_unlock(t_context->mutex);
+        size_t pairs = ReduceQueue::pairsOf(task);
+        reduce_task(t_context, task, groups);
+        group_arena.reset();
+        t_context->processed_count++;
+        t_context->progress->store(t_context->progress->load(
+                std::memory_order_relaxed) + pairs, std::memory_order_relaxed);
     }
+    if (sorted) {
+        place_sorted_output(t_context, groups);
+    }
+    if (t_context->chained_map != nullptr) {
+        sort_run(t_context->chained_map);
+    }
+    jobLog(LOG_THREAD_TERMINATED, t_context->thread_id, REDUCE_STAGE,
+           t_context->processed_count);
     return nullptr;
 }
 
@@ -184,180 +965,860 @@ void *reduce_phase(void *context) {
 // *********************** Framework functions **********************
 // ******************************************************************
 
-JobHandle startMapReduceJob(const MapReduceClient &client,
-                            const InputVec &inputVec, OutputVec &outputVec,
-                            int multiThreadLevel) {
-    current_state.stage = UNDEFINED_STAGE;
-    current_state.percentage = 0.0;
+// the sorted runs a job's map threads leave for its shuffle, one per
+// thread. In a chain the reducers of the job before are the map threads
+typedef struct StageRuns {
+    PaddedArray<IntermediateVec> pairs;
+    PaddedArray<RecordVec> records;
+    PaddedArray<Arena> record_pages;
+    PaddedArray<std::vector<CompressedRun>> compressed;
+    // NUMA node of every map thread, the node its run lives on
+    std::vector<int> nodes;
+
+    explicit StageRuns(int threads)
+            : pairs(threads), records(threads), record_pages(threads),
+              compressed(threads), nodes(threads, 0) {}
+} StageRuns;
+
+// the context of map thread i of a job of the chain, writing to run i
+ThreadContext mapContext(JobContext *job, const MapReduceClient *client,
+                         StageRuns &runs, int i, int threads,
+                         const CpuPlacement &placement,
+                         pthread_mutex_t *mutex, InputSplits *input_splits,
+                         std::atomic<int64_t> *progress) {
+    // a client with compact pairs has them written as records to pages
+    // owned by the job until reduce is done
+    const CompactMapReduceClient *compact =
+            dynamic_cast<const CompactMapReduceClient *>(client);
+    bool compress_runs = compact != nullptr && job->options.compress_runs;
+    return {client,
+            job->input_vec,
+            &runs.pairs[i],
+            nullptr,
+            nullptr,
+            mutex,
+            nullptr,
+            threads,
+            &job->state,
+            &runs.pairs,
+            nullptr,
+            i,
+            placement,
+            0,
+            nullptr,
+            nullptr,
+            nullptr,
+            &(*job->arenas)[i],
+            nullptr,
+            &job->dictionary,
+            compact,
+            &runs.record_pages[i],
+            &runs.records[i],
+            compress_runs ? &runs.compressed[i] : nullptr,
+            &job->cancellation,
+            progress,
+            nullptr,
+            nullptr,
+            0,
+            nullptr,
+            nullptr,
+            input_splits,
+            nullptr};
+}
+
+// a cancelled job drops the runs it didn't shuffle; pairs go to the
+// client's discard, records go with the runs
+void discard_runs(const MapReduceClient *client, StageRuns &runs) {
+    for (size_t i = 0; i < runs.pairs.size(); ++i) {
+        if (not runs.pairs[i].empty()) {
+            client->discard(&runs.pairs[i]);
+        }
+    }
+}
+
+// a map-only job's context of map thread i: emit3 appends to its output
+// buffer, emitAggregate folds into accumulator i of aggregation (if any),
+// it has no run
+ThreadContext mapOnlyContext(JobContext *job, int i, int threads,
+                             const CpuPlacement &placement,
+                             OutputVec *output, Aggregation *aggregation,
+                             InputSplits *input_splits,
+                             std::atomic<int64_t> *progress) {
+    ThreadContext context = {};
+    context.client = job->clients[0];
+    context.input_vec = job->input_vec;
+    context.input_splits = input_splits;
+    context.multiThreadLevel = threads;
+    context.current_state = &job->state;
+    context.thread_id = i;
+    context.placement = placement;
+    context.local_output = output;
+    context.arena = &(*job->arenas)[i];
+    context.dictionary = &job->dictionary;
+    context.cancellation = &job->cancellation;
+    context.progress = progress;
+    if (aggregation != nullptr) {
+        context.accumulator = aggregation->accumulators[i];
+        context.aggregation = aggregation;
+    }
+    return context;
+}
+
+// maps the input with the first client of the chain, returns its runs.
+// A map-only job leaves no runs, its output is appended to the job's
+// output when the map threads are done and nullptr is returned
+StageRuns *map_stage(JobContext *job, pthread_mutex_t *mutex) {
+    const MapReduceClient &client = *job->clients[0];
+    const InputVec &inputVec = *job->input_vec;
+    int multiThreadLevel = job->multiThreadLevel;
+    const JobOptions &options = job->options;
+
+    struct timespec stage_begin;
+    clock_gettime(CLOCK_MONOTONIC, &stage_begin);
+    jobLog(LOG_STAGE_STARTED, -1, MAP_STAGE);
+
+    // in auto mode the first records are mapped here, their pairs are handed
+    // to thread 0 and the dispenser starts after them
+    IntermediateVec warmup_vec;
+    RecordVec warmup_records;
+    Arena warmup_pages;
+    OutputVec warmup_output;
+    V3 *warmup_accumulator = nullptr;
+    int warmed_up = 0;
+    int64_t nanos_per_record = 0;
+    if (multiThreadLevel <= 0) {
+        ThreadContext warmup_context = {};
+        warmup_context.arena = &job->warmup_arena;
+        warmup_context.dictionary = &job->dictionary;
+        if (job->map_only) {
+            warmup_context.local_output = &warmup_output;
+            if (job->aggregate != nullptr) {
+                warmup_accumulator = job->aggregate->init();
+                warmup_context.client = &client;
+                warmup_context.accumulator = warmup_accumulator;
+            }
+        } else {
+            warmup_context.intermediate_vec = &warmup_vec;
+            warmup_context.compact =
+                    dynamic_cast<const CompactMapReduceClient *>(&client);
+            warmup_context.record_pages = &warmup_pages;
+            warmup_context.records = &warmup_records;
+        }
+        warmed_up = warmUp(client, inputVec, &warmup_context, &nanos_per_record);
+    }
+    multiThreadLevel = chooseThreadCount(multiThreadLevel, options.max_threads,
+                                         (int) inputVec.size() - warmed_up,
+                                         nanos_per_record);
+    job->multiThreadLevel = multiThreadLevel;
 
     // create empty vector for all the threads
     std::vector<pthread_t> map_threads(multiThreadLevel);
 
     // This vector is used to store the intermediate results generated by each thread during the Map phase.
-    std::vector<IntermediateVec> intermediateVectors(multiThreadLevel);
-
-    // mutex locks that are used to synchronize the access to the shared vectors
-    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-    // init the mutex
-    pthread_mutex_init(&mutex, NULL);
+    StageRuns *runs = new StageRuns(multiThreadLevel);
+    job->arenas = new PaddedArray<Arena>(multiThreadLevel);
+    runs->pairs[0].swap(warmup_vec);
+    runs->records[0].swap(warmup_records);
+    // the warm-up records point into warmup_pages, which go with them
+    runs->record_pages[0].swap(warmup_pages);
+    // map-only: every thread's output buffer, the warm-up's is thread 0's
+    PaddedArray<OutputVec> map_outputs(job->map_only ? multiThreadLevel : 0);
+    if (job->map_only) {
+        map_outputs[0].swap(warmup_output);
+    }
+    // aggregate jobs: one accumulator per thread, the warm-up's is
+    // thread 0's
+    Aggregation aggregation;
+    if (job->aggregate != nullptr) {
+        aggregation.client = job->aggregate;
+        aggregation.accumulators.resize(multiThreadLevel);
+        for (int i = 0; i < multiThreadLevel; ++i) {
+            aggregation.accumulators[i] = i == 0 && warmup_accumulator != nullptr
+                                          ? warmup_accumulator
+                                          : job->aggregate->init();
+        }
+        aggregation.merged.resize(multiThreadLevel, false);
+        pthread_mutex_init(&aggregation.mutex, NULL);
+        pthread_cond_init(&aggregation.merged_cond, NULL);
+    }
 
     // an array to store all the context for each thread
-    ThreadContext map_thread_contexts[multiThreadLevel];
-
-    // atomic counter that are used to keep track of the number of Map and Reduce tasks
-    // that have been completed by each thread
-    std::atomic<int> atomicCounter(0);
-
-    current_state.stage = MAP_STAGE;
+    PaddedArray<ThreadContext> map_thread_contexts(multiThreadLevel);
+
+    // the records after the warm-up ones, in contiguous ranges split by the
+    // client's cost estimate if it has one
+    std::vector<double> costs;
+    bool estimated = client.estimateMapCosts(inputVec, &costs)
+                     && costs.size() == inputVec.size();
+    InputSplits input_splits(multiThreadLevel, warmed_up, (int) inputVec.size(),
+                             estimated ? &costs : nullptr);
+
+    // the threads that are done mapping help sort the large runs
+    SortPool sort_pool;
+    pthread_mutex_init(&sort_pool.mutex, NULL);
+    pthread_cond_init(&sort_pool.changed, NULL);
+    sort_pool.mapping = multiThreadLevel;
+
+    // MAP_STAGE progress: records mapped (the warm-up ones already are)
+    // out of the input
+    ProgressCounters map_progress(multiThreadLevel);
+    setJobStage(job, MAP_STAGE, {&map_progress, warmed_up,
+                                 (int64_t) inputVec.size()});
+
+    jobLog(LOG_JOB_STARTED, -1, multiThreadLevel, inputVec.size());
 
     for (int i = 0; i < multiThreadLevel; ++i) {
-        map_thread_contexts[i] = {&client,
-                                  &inputVec,
-                                  &intermediateVectors[i],
-                                  nullptr,
-                                  nullptr,
-                                  &mutex,
-                                  &atomicCounter,
-                                  multiThreadLevel,
-                                  &current_state,
-                                  &intermediateVectors,
-                                  0};
-        if (pthread_create(&map_threads[i], NULL, map_phase,
-                           (void *) &map_thread_contexts[i])) {
-            std::cerr << "Error creating thread" << std::endl;
-            exit(1);
+        CpuPlacement placement = affinityPlacement(options.affinity, i);
+        runs->nodes[i] = placement.node;
+        if (job->map_only) {
+            map_thread_contexts[i] = mapOnlyContext(
+                    job, i, multiThreadLevel, placement, &map_outputs[i],
+                    job->aggregate != nullptr ? &aggregation : nullptr,
+                    &input_splits, &map_progress[i]);
+        } else {
+            map_thread_contexts[i] = mapContext(job, &client, *runs, i,
+                                                multiThreadLevel, placement,
+                                                mutex, &input_splits,
+                                                &map_progress[i]);
+            if (multiThreadLevel > 1) {
+                map_thread_contexts[i].sort_pool = &sort_pool;
+            }
         }
+        createThread(&map_threads[i], map_phase,
+                     (void *) &map_thread_contexts[i], placement);
     }
 
     // Wait for the threads to finish and collect their intermediate results
     WaitContext curr_wait = {&map_threads, multiThreadLevel};
-    waitForJob(&curr_wait);
-
-    // Update the job state to the shuffle phase
-    current_state.stage = SHUFFLE_STAGE;
-    sem_t shuffle_sem;
-    sem_init(&shuffle_sem, 0, 0);
-    ShuffledQueue_t *queue;
-    ShuffleContext shuffle_context = {
-            &mutex,
-            &atomicCounter,
-            &current_state,
-            &intermediateVectors,
-            &shuffle_sem,
-            queue,
-            multiThreadLevel};
-
-    // NOW perform the shuffle phase:
-
+    joinThreads(&curr_wait);
+    pthread_mutex_destroy(&sort_pool.mutex);
+    pthread_cond_destroy(&sort_pool.changed);
+    jobLog(LOG_STAGE_FINISHED, -1, MAP_STAGE, elapsedNanos(stage_begin));
+    // the counters go with this frame, the percentage stays where it is
+    setJobStage(job, MAP_STAGE);
+    if (job->map_only) {
+        // what was mapped before a cancellation is kept too
+        OutputVec &outputVec = *job->output_vec;
+        size_t total = outputVec.size();
+        for (int i = 0; i < multiThreadLevel; ++i) {
+            total += map_outputs[i].size();
+        }
+        outputVec.reserve(total);
+        for (int i = 0; i < multiThreadLevel; ++i) {
+            outputVec.insert(outputVec.end(), map_outputs[i].begin(),
+                             map_outputs[i].end());
+        }
+        if (job->aggregate != nullptr) {
+            // thread 0 merged every accumulator into its own, which is
+            // partial only if a map thread stopped early
+            if (job->cancellation.stopped.load()) {
+                delete aggregation.accumulators[0];
+            } else {
+                outputVec.emplace_back(job->aggregate->aggregateKey(),
+                                       aggregation.accumulators[0]);
+            }
+            pthread_mutex_destroy(&aggregation.mutex);
+            pthread_cond_destroy(&aggregation.merged_cond);
+        }
+        delete runs;
+        return nullptr;
+    }
+    return runs;
+}
 
-    // create a new thread for the shuffle:
-    pthread_t shuffle_thread;
+// top_k: merges the reducers' heaps into the top_k best outputs of the
+// job, dropping the others, and appends them to the output best first
+void merge_top(const RankedMapReduceClient *client,
+               PaddedArray<OutputVec> &heaps, size_t top_k,
+               OutputVec *output_vec) {
+    OutputVec top;
+    for (size_t i = 0; i < heaps.size(); i++) {
+        top.insert(top.end(), heaps[i].begin(), heaps[i].end());
+    }
+    RankLess less{client};
+    if (top.size() > top_k) {
+        std::nth_element(top.begin(), top.begin() + top_k, top.end(), less);
+        for (auto it = top.begin() + top_k; it != top.end(); ++it) {
+            client->dropOutput(it->first, it->second);
+        }
+        top.resize(top_k);
+    }
+    std::sort(top.begin(), top.end(), less);
+    output_vec->insert(output_vec->end(), top.begin(), top.end());
+}
 
-    if (pthread_create(&shuffle_thread, NULL, shuffle_phase,
-                       (void *) &shuffle_context)) {
-        std::cerr << "Error creating thread" << std::endl;
-        exit(1);
+// shuffles and reduces the runs of job number stage of the chain. The
+// reducers of a job that has one after it map their output right away
+// with the next client, the runs they leave are returned (else nullptr)
+StageRuns *reduce_stage(JobContext *job, size_t stage, StageRuns &runs,
+                        pthread_mutex_t *mutex) {
+    const MapReduceClient &client = *job->clients[stage];
+    const MapReduceClient *next_client = stage + 1 < job->clients.size()
+                                         ? job->clients[stage + 1] : nullptr;
+    const InputVec &inputVec = *job->input_vec;
+    OutputVec &outputVec = *job->output_vec;
+    const JobOptions &options = job->options;
+    int run_count = (int) runs.pairs.size();
+    const CompactMapReduceClient *compact =
+            dynamic_cast<const CompactMapReduceClient *>(&client);
+    bool compress_runs = compact != nullptr && options.compress_runs;
+
+    // the reducers start with the shuffle and take groups as soon as they
+    // are merged, there are never more of them than pairs to reduce
+    size_t pair_count = 0;
+    for (int i = 0; i < run_count; ++i) {
+        pair_count += runs.pairs[i].size() + runs.records[i].size();
+        for (const CompressedRun &run: runs.compressed[i]) {
+            pair_count += run.records;
+        }
     }
+    int reduce_thread_count = (int) std::min((size_t) job->multiThreadLevel,
+                                             pair_count);
 
-    // Wait for shuffle thread to finish
-    sem_wait(&shuffle_sem);
+    // Update the job state to the shuffle phase
+    struct timespec stage_begin;
+    clock_gettime(CLOCK_MONOTONIC, &stage_begin);
+    // SHUFFLE_STAGE progress: pairs merged into groups, REDUCE_STAGE
+    // progress: pairs reduced, counted from the first group on
+    ProgressCounters shuffle_progress(1);
+    setJobStage(job, SHUFFLE_STAGE, {&shuffle_progress, 0, (int64_t) pair_count});
+    jobLog(LOG_STAGE_STARTED, -1, SHUFFLE_STAGE);
+    ReduceQueue reduce_queue(REDUCE_QUEUE_PAIRS);
+    int group_count = 0;
+    std::atomic<int> atomicCounter(0);
 
-    int key_count=0;
+    // skew: a mergeable client's hot groups are split into several tasks
+    std::deque<SplitGroup> splits;
+    size_t split_threshold =
+            dynamic_cast<const MergeableMapReduceClient *>(&client) != nullptr
+            ? options.split_threshold : 0;
+
+    // top_k: the last job's reducers keep their best outputs in heaps
+    const RankedMapReduceClient *ranked =
+            next_client == nullptr && options.top_k > 0
+            ? dynamic_cast<const RankedMapReduceClient *>(&client) : nullptr;
+    PaddedArray<OutputVec> top_heaps(ranked != nullptr ? reduce_thread_count : 0);
+
+    // sorted output: outputs are placed by group index once reduce is done,
+    // there are at most as many groups as pairs. Only the last job of a
+    // chain has output
+    std::vector<size_t> group_sizes;
+    pthread_barrier_t output_barrier;
+    bool sorted_output = options.sorted_output && next_client == nullptr
+                         && ranked == nullptr && reduce_thread_count > 0;
+    if (sorted_output) {
+        group_sizes.resize(pair_count, 0);
+        pthread_barrier_init(&output_barrier, NULL, reduce_thread_count);
+    }
 
-    // Update the job state to the reduce phase
-    current_state.stage = REDUCE_STAGE;
+    // chains: reducer i maps into run i of the next job
+    StageRuns *next_runs = next_client != nullptr
+                           ? new StageRuns(reduce_thread_count) : nullptr;
+    PaddedArray<ThreadContext> next_map_contexts(
+            next_client != nullptr ? reduce_thread_count : 0);
 
     // create empty vector for all the threads
-    std::vector<pthread_t> reduce_threads(multiThreadLevel);
+    std::vector<pthread_t> reduce_threads(reduce_thread_count);
+    ProgressCounters reduce_progress(reduce_thread_count);
 
     // an array to store all the context for each thread
-    ThreadContext reduce_threads_context[multiThreadLevel];
-
-    // TODO: check if need to run with the same threads from the map or create new as we did
-
-    for (int i = 0; i < multiThreadLevel; ++i) {
+    PaddedArray<ThreadContext> reduce_threads_context(reduce_thread_count);
+
+    for (int i = 0; i < reduce_thread_count; ++i) {
+        CpuPlacement placement = affinityPlacement(options.affinity, i);
+        ThreadContext *chained_map = nullptr;
+        if (next_runs != nullptr) {
+            next_runs->nodes[i] = placement.node;
+            next_map_contexts[i] = mapContext(job, next_client, *next_runs, i,
+                                              reduce_thread_count, placement,
+                                              mutex, nullptr, nullptr);
+            chained_map = &next_map_contexts[i];
+        }
         reduce_threads_context[i] = {&client,
                                      &inputVec,
-                                     &intermediateVectors[i],
-                                     queue,
+                                     nullptr,
+                                     &reduce_queue,
                                      &outputVec,
-                                     &mutex,
+                                     mutex,
                                      &atomicCounter,
-                                     multiThreadLevel,
-                                     &current_state,
-                                     &intermediateVectors,
-                                     key_count};
-        if (pthread_create(&reduce_threads[i], NULL, reduce_phase,
-                           (void *) &reduce_threads_context[i])) {
-            std::cerr << "Error creating thread" << std::endl;
-            exit(1);
-        }
+                                     reduce_thread_count,
+                                     &job->state,
+                                     &runs.pairs,
+                                     &group_count,
+                                     i,
+                                     placement,
+                                     0,
+                                     nullptr,
+                                     sorted_output ? &group_sizes : nullptr,
+                                     &output_barrier,
+                                     &(*job->arenas)[i],
+                                     nullptr,
+                                     &job->dictionary,
+                                     compact,
+                                     nullptr,
+                                     nullptr,
+                                     nullptr,
+                                     &job->cancellation,
+                                     &reduce_progress[i],
+                                     chained_map,
+                                     ranked != nullptr ? &top_heaps[i] : nullptr,
+                                     options.top_k,
+                                     nullptr,
+                                     nullptr,
+                                     nullptr,
+                                     nullptr};
+        createThread(&reduce_threads[i], reduce_phase,
+                     (void *) &reduce_threads_context[i], placement);
     }
 
+    // the shuffle runs next to the reducers draining its queue, so it may
+    // use any cpu of run 0's node but isn't pinned to one of theirs
+    CpuPlacement shuffle_placement =
+            affinityNodePlacement(options.affinity, runs.nodes[0]);
+    ShuffleContext shuffle_context = {
+            mutex,
+            &atomicCounter,
+            &job->state,
+            &runs.pairs,
+            &reduce_queue,
+            run_count,
+            &runs.nodes,
+            shuffle_placement.node,
+            &group_count,
+            split_threshold,
+            reduce_thread_count,
+            &splits,
+            &runs.records,
+            compact,
+            compress_runs ? &runs.compressed : nullptr,
+            &client,
+            &job->cancellation,
+            &shuffle_progress[0]};
+
+    // create a new thread for the shuffle:
+    pthread_t shuffle_thread;
+
+    createThread(&shuffle_thread, shuffle_phase, (void *) &shuffle_context,
+                 shuffle_placement);
+
+    // Wait for shuffle thread to finish, the reducers are still draining
+    // the last groups it queued
+    pthread_join(shuffle_thread, NULL);
+    jobLog(LOG_STAGE_FINISHED, -1, SHUFFLE_STAGE, elapsedNanos(stage_begin));
+
+    // Update the job state to the reduce phase
+    clock_gettime(CLOCK_MONOTONIC, &stage_begin);
+    setJobStage(job, REDUCE_STAGE, {&reduce_progress, 0, (int64_t) pair_count});
+    jobLog(LOG_STAGE_STARTED, -1, REDUCE_STAGE);
+
     // Wait for the threads to finish
-    curr_wait = {&reduce_threads, multiThreadLevel};
-    waitForJob(&curr_wait);
+    WaitContext curr_wait = {&reduce_threads, reduce_thread_count};
+    joinThreads(&curr_wait);
+    jobLog(LOG_STAGE_FINISHED, -1, REDUCE_STAGE, elapsedNanos(stage_begin));
+    if (sorted_output) {
+        pthread_barrier_destroy(&output_barrier);
+    }
+    if (ranked != nullptr) {
+        merge_top(ranked, top_heaps, options.top_k, &outputVec);
+    }
+    setJobStage(job, REDUCE_STAGE);
+    return next_runs;
+}
+
+// the jobs of a chain started by startMapReduceChain, on the job's own
+// thread. Each job's runs are freed as soon as it is reduced
+void run_stages(JobContext *job) {
+    OutputVec &outputVec = *job->output_vec;
+
+    // mutex locks that are used to synchronize the access to the shared vectors
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    // init the mutex
+    pthread_mutex_init(&mutex, NULL);
 
+    StageRuns *runs = map_stage(job, &mutex);
+    // a map-only job has kept its output already, it is cancelled only if
+    // a map thread stopped early
+    if (runs == nullptr ? job->cancellation.stopped.load()
+                        : jobCancelled(&job->cancellation)) {
+        // nothing was shuffled yet, the runs are dropped here
+        if (runs != nullptr) {
+            discard_runs(job->clients[0], *runs);
+            delete runs;
+        }
+        pthread_mutex_destroy(&mutex);
+        jobLog(LOG_JOB_CANCELLED, -1, job->cancellation.stopped_stage,
+               outputVec.size());
+        setJobStage(job, CANCELLED_STAGE);
+        return;
+    }
+
+    for (size_t stage = 0; runs != nullptr && stage < job->clients.size();
+         stage++) {
+        StageRuns *next_runs = reduce_stage(job, stage, *runs, &mutex);
+        delete runs;
+        runs = next_runs;
+        if (runs != nullptr && jobCancelled(&job->cancellation)) {
+            discard_runs(job->clients[stage + 1], *runs);
+            delete runs;
+            break;
+        }
+    }
 
-    current_state.stage = UNDEFINED_STAGE;
-    current_state.percentage = 100;
+    // only a request that stopped a worker counts, one that arrives (or a
+    // deadline that passes) after the last group doesn't cancel the job
+    if (job->cancellation.stopped.load()) {
+        jobLog(LOG_JOB_CANCELLED, -1, job->cancellation.stopped_stage,
+               outputVec.size());
+        setJobStage(job, CANCELLED_STAGE);
+    } else {
+        // a finished job stays in REDUCE_STAGE at 100%
+        jobLog(LOG_JOB_FINISHED, -1, outputVec.size());
+        setJobStage(job, REDUCE_STAGE);
+    }
 
     // Free resources
     pthread_mutex_destroy(&mutex);
-    sem_destroy(&shuffle_sem);
-    // TODO: CHECK WHAT TO send to this function
-    closeJobHandle(&shuffle_context);
+}
+
+// wakes everyone waiting for the job, the callback runs last and unlocked
+// so it may read the job's state
+void *run_job(void *context) {
+    JobContext *job = (JobContext *) context;
+    run_stages(job);
+
+    pthread_mutex_lock(&job->done_mutex);
+    job->done = true;
+    pthread_cond_broadcast(&job->done_cond);
+    if (job->event_fd >= 0) {
+        uint64_t one = 1;
+        if (write(job->event_fd, &one, sizeof(one)) != sizeof(one)) {
+            std::cerr << "Error signaling job eventfd" << std::endl;
+        }
+    }
+    job_callback_t callback = job->callback;
+    void *callback_arg = job->callback_arg;
+    pthread_mutex_unlock(&job->done_mutex);
+    if (callback != nullptr) {
+        callback(job, callback_arg);
+    }
+    return nullptr;
+}
+
+// starts the job thread of a chain, or of a map-only job (that aggregates
+// with aggregate, unless it is nullptr)
+JobHandle start_job(const std::vector<const MapReduceClient *> &clients,
+                    const InputVec &inputVec, OutputVec &outputVec,
+                    int multiThreadLevel, const JobOptions &options,
+                    bool map_only, const AggregateMapReduceClient *aggregate) {
+    JobContext *job = new JobContext();
+    job->clients = clients;
+    job->input_vec = &inputVec;
+    job->output_vec = &outputVec;
+    job->multiThreadLevel = multiThreadLevel;
+    job->options = options;
+    job->map_only = map_only;
+    job->aggregate = aggregate;
+    if (options.deadline_ms > 0) {
+        job->cancellation.deadline = monotonicNanos()
+                                     + options.deadline_ms * 1000000L;
+    }
+    job->state.stage = MAP_STAGE;
+    createThread(&job->thread, run_job, (void *) job,
+                 affinityPlacement(AFFINITY_NONE, 0));
+    return job;
+}
+
+JobHandle startMapReduceChain(const std::vector<const MapReduceClient *> &clients,
+                              const InputVec &inputVec, OutputVec &outputVec,
+                              int multiThreadLevel, const JobOptions &options) {
+    if (clients.empty()) {
+        std::cerr << "Error: a chain needs at least one client" << std::endl;
+        exit(1);
+    }
+    for (size_t i = 1; i < clients.size(); i++) {
+        if (dynamic_cast<const ChainedMapReduceClient *>(clients[i]) == nullptr) {
+            std::cerr << "Error: client " << i << " of a chain isn't a "
+                      << "ChainedMapReduceClient" << std::endl;
+            exit(1);
+        }
+    }
+    return start_job(clients, inputVec, outputVec, multiThreadLevel, options,
+                     false, nullptr);
+}
+
+JobHandle startMapReduceJob(const MapReduceClient &client,
+                            const InputVec &inputVec, OutputVec &outputVec,
+                            int multiThreadLevel, const JobOptions &options) {
+    return startMapReduceChain({&client}, inputVec, outputVec,
+                               multiThreadLevel, options);
+}
+
+JobHandle startMapOnlyJob(const MapReduceClient &client,
+                          const InputVec &inputVec, OutputVec &outputVec,
+                          int multiThreadLevel, const JobOptions &options) {
+    return start_job({&client}, inputVec, outputVec, multiThreadLevel, options,
+                     true, nullptr);
+}
 
-    // TODO: CHECK WHAT TO RETURN AND MAYBE CHANGE THE current_state variable
-    return NULL;
+JobHandle startAggregateJob(const AggregateMapReduceClient &client,
+                            const InputVec &inputVec, OutputVec &outputVec,
+                            int multiThreadLevel, const JobOptions &options) {
+    return start_job({&client}, inputVec, outputVec, multiThreadLevel, options,
+                     true, &client);
 }
 
 
 void emit2(K2 *key, V2 *value, void *context) {
-//    pthread_mutex_lock(t_context->mutex);
     ThreadContext *t_context = (ThreadContext *) context;
-    IntermediatePair *pair = new IntermediatePair(key, value);
-    t_context->intermediate_vec->push_back(*pair);
-//    pthread_mutex_unlock(t_context->mutex);
+    if (t_context->compact != nullptr) {
+        // serialized through a buffer the thread reuses, key and value
+        // stay the map's
+        thread_local std::vector<char> bytes;
+        bytes.clear();
+        t_context->compact->serializeKey(key, &bytes);
+        size_t key_size = bytes.size();
+        t_context->compact->serializeValue(value, &bytes);
+        t_context->records->push_back(compactWriteRecord(
+                t_context->record_pages, bytes.data(), key_size,
+                bytes.size() - key_size));
+        if (t_context->compressed_runs != nullptr
+            && t_context->records->size() >= RUN_SPILL_RECORDS) {
+            spill_records(t_context);
+        }
+        return;
+    }
+    if (t_context->intermediate_vec == nullptr) {
+        std::cerr << "Error: emit2 called outside the map of a job with "
+                  << "intermediate pairs" << std::endl;
+        exit(1);
+    }
+    t_context->intermediate_vec->emplace_back(key, value);
+}
+
+void emit2Batch(const IntermediatePair *pairs, size_t n, void *context) {
+    ThreadContext *t_context = (ThreadContext *) context;
+    if (t_context->compact != nullptr) {
+        // every pair is serialized to a record of its own
+        for (size_t i = 0; i < n; ++i) {
+            emit2(pairs[i].first, pairs[i].second, context);
+        }
+        return;
+    }
+    if (t_context->intermediate_vec == nullptr) {
+        std::cerr << "Error: emit2Batch called outside the map of a job with "
+                  << "intermediate pairs" << std::endl;
+        exit(1);
+    }
+    t_context->intermediate_vec->insert(t_context->intermediate_vec->end(),
+                                        pairs, pairs + n);
+}
+
+
+IntermediatePair *emit2Reserve(size_t n, void *context) {
+    ThreadContext *t_context = (ThreadContext *) context;
+    if (t_context->compact != nullptr || t_context->intermediate_vec == nullptr) {
+        std::cerr << "Error: emit2Reserve called outside the map of a job with "
+                  << "intermediate pairs as objects" << std::endl;
+        exit(1);
+    }
+    IntermediateVec &vec = *t_context->intermediate_vec;
+    size_t size = vec.size();
+    vec.resize(size + n);
+    return vec.data() + size;
+}
+
+
+// top_k: keeps an output in the reducer's heap, whose front is the kept
+// output that ranks last, if it is among the best top_k so far. Whatever
+// leaves the top is dropped right away
+void keep_top(ThreadContext *t_context, K3 *key, V3 *value) {
+    const RankedMapReduceClient *client =
+            (const RankedMapReduceClient *) t_context->client;
+    OutputVec &heap = *t_context->top_output;
+    RankLess less{client};
+    if (heap.size() < t_context->top_k) {
+        heap.emplace_back(key, value);
+        std::push_heap(heap.begin(), heap.end(), less);
+        return;
+    }
+    if (not less(OutputPair(key, value), heap.front())) {
+        client->dropOutput(key, value);
+        return;
+    }
+    std::pop_heap(heap.begin(), heap.end(), less);
+    client->dropOutput(heap.back().first, heap.back().second);
+    heap.back() = OutputPair(key, value);
+    std::push_heap(heap.begin(), heap.end(), less);
 }
 
 
 void emit3(K3 *key, V3 *value, void *context)
 {
     ThreadContext *t_context = (ThreadContext *) context;
-    OutputPair *pair=new OutputPair(key,value);
-    t_context->output_vec->push_back(*pair);
+    if (t_context->partial_output != nullptr) {
+        t_context->partial_output->emplace_back(key, value);
+        return;
+    }
+    if (t_context->chained_map != nullptr) {
+        ThreadContext *chained_map = t_context->chained_map;
+        ((const ChainedMapReduceClient *) chained_map->client)->mapOutput(
+                key, value, (void *) chained_map);
+        return;
+    }
+    if (t_context->top_output != nullptr) {
+        keep_top(t_context, key, value);
+        return;
+    }
+    if (t_context->local_output != nullptr) {
+        t_context->local_output->emplace_back(key, value);
+        return;
+    }
+    pthread_mutex_lock(t_context->mutex);
+    t_context->output_vec->emplace_back(key, value);
+    pthread_mutex_unlock(t_context->mutex);
+}
+
+
+void emitAggregate(const V2 *value, void *context) {
+    ThreadContext *t_context = (ThreadContext *) context;
+    if (t_context->accumulator == nullptr) {
+        std::cerr << "Error: emitAggregate called outside the map of an "
+                  << "aggregate job" << std::endl;
+        exit(1);
+    }
+    ((const AggregateMapReduceClient *) t_context->client)->accumulate(
+            t_context->accumulator, value);
+}
+
+
+void *emitAllocRaw(size_t size, size_t alignment, void *context) {
+    ThreadContext *t_context = (ThreadContext *) context;
+    return t_context->arena->allocate(size, alignment);
+}
+
+
+void emitAllocDestructor(void (*destroy)(void *), void *object, void *context) {
+    ThreadContext *t_context = (ThreadContext *) context;
+    t_context->arena->addDestructor(destroy, object);
+}
+
+
+uint32_t internKey(const char *data, size_t length, void *context) {
+    ThreadContext *t_context = (ThreadContext *) context;
+    return t_context->dictionary->intern(data, length);
+}
+
+
+InternedKey *emitInternedKey(const char *data, size_t length, void *context) {
+    return emitAlloc<InternedKey>(context, internKey(data, length, context));
+}
+
+
+const std::string &internedKeyString(uint32_t id, void *context) {
+    ThreadContext *t_context = (ThreadContext *) context;
+    return t_context->dictionary->lookup(id);
+}
+
+
+// joins the job thread of a completed job, which at most still runs the
+// callback
+void joinJob(JobContext *job) {
+    pthread_mutex_lock(&job->join_mutex);
+    if (not job->joined) {
+        pthread_join(job->thread, NULL);
+        job->joined = true;
+    }
+    pthread_mutex_unlock(&job->join_mutex);
 }
 
 
 void waitForJob(JobHandle job) {
-    WaitContext *curr = (WaitContext *) job;
-    for (int i = 0; i < curr->multiThreadLevel; i++) {
-        pthread_join((*curr->threads)[i], NULL);
+    JobContext *job_context = (JobContext *) job;
+    pthread_mutex_lock(&job_context->done_mutex);
+    while (not job_context->done) {
+        pthread_cond_wait(&job_context->done_cond, &job_context->done_mutex);
     }
+    pthread_mutex_unlock(&job_context->done_mutex);
+    joinJob(job_context);
 }
 
 
-void getJobState(JobHandle job, JobState *state) {
-    ThreadContext *t_job = (ThreadContext *) job;
-    state->stage = t_job->current_state->stage;
-    state->percentage = t_job->current_state->percentage;
+bool waitForJobTimeout(JobHandle job, int64_t timeout_ms) {
+    JobContext *job_context = (JobContext *) job;
+    int64_t deadline = monotonicNanos() + timeout_ms * 1000000L;
+    struct timespec until;
+    until.tv_sec = deadline / 1000000000L;
+    until.tv_nsec = deadline % 1000000000L;
+    pthread_mutex_lock(&job_context->done_mutex);
+    int result = 0;
+    while (not job_context->done && result != ETIMEDOUT) {
+        result = pthread_cond_timedwait(&job_context->done_cond,
+                                        &job_context->done_mutex, &until);
+    }
+    bool done = job_context->done;
+    pthread_mutex_unlock(&job_context->done_mutex);
+    if (done) {
+        joinJob(job_context);
+    }
+    return done;
 }
 
 
-void closeJobHandle(JobHandle job) {
-    ShuffleContext *t_job = (ShuffleContext *) job;
-    for (auto vec: *(t_job->intermediate_vecs)) {
-        for (auto pair: vec) {
-            delete &pair;
-        }
+void setJobCallback(JobHandle job, job_callback_t callback, void *arg) {
+    JobContext *job_context = (JobContext *) job;
+    pthread_mutex_lock(&job_context->done_mutex);
+    bool done = job_context->done;
+    job_context->callback = callback;
+    job_context->callback_arg = arg;
+    pthread_mutex_unlock(&job_context->done_mutex);
+    if (done && callback != nullptr) {
+        callback(job, arg);
+    }
+}
+
+
+int getJobEventFd(JobHandle job) {
+    JobContext *job_context = (JobContext *) job;
+    pthread_mutex_lock(&job_context->done_mutex);
+    if (job_context->event_fd < 0) {
+        // a job that already completed starts out readable
+        job_context->event_fd = eventfd(job_context->done ? 1 : 0, EFD_CLOEXEC);
+    }
+    int event_fd = job_context->event_fd;
+    pthread_mutex_unlock(&job_context->done_mutex);
+    return event_fd;
+}
+
+
+void cancelJob(JobHandle job) {
+    JobContext *job_context = (JobContext *) job;
+    job_context->cancellation.requested.store(true);
+}
+
+
+bool setJobLogPath(const char *path) {
+    if (path == nullptr) {
+        jobLogClose();
+        return true;
     }
-    while(not t_job->queue->empty())
-    // TODO: check what do delete inside the vec
-    {
-        auto temp = t_job->queue->front();
-        t_job->queue->pop();
-        delete &temp;
+    return jobLogOpen(path);
+}
+
+
+void getJobState(JobHandle job, JobState *state) {
+    JobContext *job_context = (JobContext *) job;
+    pthread_mutex_lock(&job_context->state_mutex);
+    *state = job_context->state;
+    if (job_context->progress.counters != nullptr) {
+        state->percentage = progressPercentage(job_context->progress);
     }
+    pthread_mutex_unlock(&job_context->state_mutex);
 }
 
+
+void closeJobHandle(JobHandle job) {
+    // the intermediate pairs were handed to (and freed by) the client's
+    // reduce, what is left are the emitAlloc arenas, released by ~Arena
+    waitForJob(job);
+    delete (JobContext *) job;
+}
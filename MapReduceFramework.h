@@ -2,6 +2,12 @@
 #define MAPREDUCEFRAMEWORK_H
 
 #include "MapReduceClient.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 /*
     Description: JobHandle is a type definition used to represent a handle or
@@ -14,22 +20,78 @@ typedef void *JobHandle;
     Description: stage_t is an enumeration that represents the different stages of a
     MapReduce job. It defines four possible stages: UNDEFINED_STAGE, MAP_STAGE,
     SHUFFLE_STAGE, and REDUCE_STAGE, with corresponding integer values.
+    CANCELLED_STAGE is the final stage of a job stopped by cancelJob or by
+    its deadline.
 */
 enum stage_t {
-    UNDEFINED_STAGE = 0, MAP_STAGE = 1, SHUFFLE_STAGE = 2, REDUCE_STAGE = 3
+    UNDEFINED_STAGE = 0, MAP_STAGE = 1, SHUFFLE_STAGE = 2, REDUCE_STAGE = 3,
+    CANCELLED_STAGE = 4
 };
 
 /*
     Description: JobState is a structure that represents the current state of a
     MapReduce job. It contains two fields: stage, which represents the current
-    stage of the job, and percentage, which indicates the progress of the job as a
-    floating-point value between 0.0 and 1.0.
+    stage of the job, and percentage, which indicates the progress of the stage
+    as a floating-point value between 0.0 and 100.0: input records mapped in
+    MAP_STAGE, intermediate pairs merged into groups in SHUFFLE_STAGE and
+    intermediate pairs reduced in REDUCE_STAGE. A finished job stays in
+    REDUCE_STAGE at 100.0, a cancelled one keeps the percentage it reached.
 */
 typedef struct {
     stage_t stage;
     float percentage;
 } JobState;
 
+/*
+    Description: affinity_policy_t selects how worker threads are pinned to
+    cpus. AFFINITY_NONE leaves placement to the scheduler. AFFINITY_COMPACT
+    fills the cpus of one NUMA node before moving to the next, and
+    AFFINITY_SCATTER spreads consecutive workers round-robin across nodes.
+    Pinned workers allocate their own emit2 buffers, so the buffers live on
+    the worker's node, and the shuffle merge reads node-local runs first.
+*/
+enum affinity_policy_t {
+    AFFINITY_NONE = 0, AFFINITY_COMPACT = 1, AFFINITY_SCATTER = 2
+};
+
+/*
+    Description: JobOptions holds the optional tuning knobs of a job. A
+    default constructed JobOptions gives the plain MapReduce behaviour.
+    max_threads caps the number of worker threads of each stage (0 means no
+    cap besides the one the framework picks in auto mode).
+    sorted_output appends the output in the order of the reduce groups (the
+    K2 order) instead of the order reducers finish in. For reducers whose K3
+    follows their K2 order, such as emitting the same key, outputVec comes
+    out sorted by K3 without sorting it afterwards.
+    split_threshold (0 disables it) only applies to a MergeableMapReduceClient:
+    a group with more pairs than this is cut into parts reduced by several
+    threads, and the parts' outputs are finalized with the client's merge.
+    compress_runs only applies to a CompactMapReduceClient: a map thread
+    sorts and compresses its records (see compressRun) into a new run every
+    time it holds a few tens of thousands and then reuses their memory, so
+    the runs waiting for the shuffle take a fraction of the memory at the
+    cost of compressing and decompressing them once.
+    deadline_ms (0 disables it) cancels the job, as cancelJob does, once it
+    has run for this many milliseconds.
+    top_k (0 disables it) only applies to a RankedMapReduceClient: outputVec
+    gets only the top_k best ranked outputs, best first, instead of
+    sorted_output's order. Every reducer keeps its best top_k in a bounded
+    heap and drops the rest as they are emitted, the heaps are merged once
+    reduce is done, so the full output is never stored or sorted.
+*/
+typedef struct JobOptions {
+    affinity_policy_t affinity;
+    int max_threads;
+    bool sorted_output;
+    size_t split_threshold;
+    bool compress_runs;
+    int64_t deadline_ms;
+    size_t top_k;
+
+    JobOptions() : affinity(AFFINITY_NONE), max_threads(0),
+                   sorted_output(false), split_threshold(0),
+                   compress_runs(false), deadline_ms(0), top_k(0) {}
+} JobOptions;
 
 /*
     Description: emit2 is a function that is typically called within the Map
@@ -40,6 +102,23 @@ typedef struct {
 */
 void emit2(K2 *key, V2 *value, void *context);
 
+/*
+    Description: emit2Batch emits the n pairs of pairs, in order, as n calls
+    to emit2 would, for a map that emits many pairs per record. The pairs
+    are appended to the thread's buffer at once; the array stays the map's.
+*/
+void emit2Batch(const IntermediatePair *pairs, size_t n, void *context);
+
+/*
+    Description: emit2Reserve appends n slots to the calling map thread's
+    buffer and returns them, for map to fill with its pairs in place. Every
+    slot must hold a pair before map returns, and the slots may move with
+    the next emit2, emit2Batch or emit2Reserve call of this context. It
+    isn't available to a CompactMapReduceClient, whose pairs are written as
+    records (see emit2Batch).
+*/
+IntermediatePair *emit2Reserve(size_t n, void *context);
+
 /*
     Description: emit3 is a function that is typically called within the Reduce
     function. It is used to emit final key-value pairs during the Reduce phase of
@@ -49,16 +128,172 @@ void emit2(K2 *key, V2 *value, void *context);
 */
 void emit3(K3 *key, V3 *value, void *context);
 
+/*
+    Description: emitAggregate is called within the Map function of a job
+    started by startAggregateJob instead of emit2: it folds value into the
+    calling map thread's accumulator with the client's accumulate. value
+    stays the map's, it can live on its stack.
+*/
+void emitAggregate(const V2 *value, void *context);
+
+/*
+    Description: emitAllocRaw returns size bytes aligned to alignment from the
+    job-owned arena of the thread running map (or reduce) with this context.
+    The memory lives until closeJobHandle and is released all at once.
+*/
+void *emitAllocRaw(size_t size, size_t alignment, void *context);
+
+/*
+    Description: emitAllocDestructor makes closeJobHandle call destroy(object)
+    before it releases the arena the object was allocated from.
+*/
+void emitAllocDestructor(void (*destroy)(void *), void *object, void *context);
+
+/*
+    Description: arena_skips_destructor tells emitAlloc that a T may be
+    released without running its destructor. It holds for trivially
+    destructible types; specialize it to std::true_type for K2/V2 types whose
+    destructor is only non-trivial because it is virtual (such as a key that
+    holds an int) to get the O(1) release for them too.
+*/
+template<typename T>
+struct arena_skips_destructor : std::is_trivially_destructible<T> {};
+
+template<typename T>
+void emitAllocDestroy(void *object) {
+    static_cast<T *>(object)->~T();
+}
+
+/*
+    Description: emitAlloc constructs a T (typically a K2 or V2) in the
+    job-owned arena of the calling map thread, so map doesn't need to new it
+    and reduce must not delete it: closeJobHandle releases every arena in
+    one go. Types with arena_skips_destructor cost nothing to release, other
+    types get their destructor run by closeJobHandle.
+    Called from reduce it allocates K3/V3 that are released in bulk with the
+    job instead of pair by pair, the output must then be read before
+    closeJobHandle. For output that outlives the job see PoolObject.
+*/
+template<typename T, typename... Args>
+T *emitAlloc(void *context, Args &&... args) {
+    void *memory = emitAllocRaw(sizeof(T), alignof(T), context);
+    T *object = ::new(memory) T(std::forward<Args>(args)...);
+    if (not arena_skips_destructor<T>::value) {
+        emitAllocDestructor(&emitAllocDestroy<T>, object, context);
+    }
+    return object;
+}
+
+/*
+    Description: InternedKey is a K2 that stands for a string by its id in
+    the job's key dictionary. Keys are ordered by id, so sorting, the
+    shuffle and grouping compare integers instead of strings; groups come
+    out in order of the keys' first appearance rather than string order.
+*/
+class InternedKey : public K2 {
+public:
+    explicit InternedKey(uint32_t id) : id(id) {}
+
+    virtual bool operator<(const K2 &other) const {
+        return id < static_cast<const InternedKey &>(other).id;
+    }
+
+    uint32_t id;
+};
+
+template<>
+struct arena_skips_destructor<InternedKey> : std::true_type {};
+
+/*
+    Description: internKey returns the id of data[0, length) in the key
+    dictionary of the job running map with this context. Every job has its
+    own dictionary, shared by all of its threads, that gives equal strings
+    the same id.
+*/
+uint32_t internKey(const char *data, size_t length, void *context);
+
+/*
+    Description: emitInternedKey returns an InternedKey for data[0, length),
+    allocated with emitAlloc, to pass to emit2.
+*/
+InternedKey *emitInternedKey(const char *data, size_t length, void *context);
+
+/*
+    Description: internedKeyString returns the string of an interned id,
+    typically in reduce to build the K3. The string belongs to the job and
+    is released by closeJobHandle, copy it into anything that outlives it.
+*/
+const std::string &internedKeyString(uint32_t id, void *context);
+
 /*
     Description: startMapReduceJob is a function that starts the execution of a
     MapReduce job. It takes several parameters, including a reference to the
     MapReduceClient, the input data vector (inputVec), the output data vector
     (outputVec), and the desired level of multi-threading (multiThreadLevel).
-    The function returns a JobHandle that can be used to interact with the running job.
+    A multiThreadLevel <= 0 selects auto mode: the framework maps the first
+    records itself to measure their cost and picks the thread count from the
+    number of cpus, the input size and that cost. In any mode a stage never
+    gets more threads than it has records (or intermediate pairs) to process.
+    The reducers start with the shuffle and reduce each group as soon as it
+    is merged; the shuffle stalls while too many pairs wait for a reducer.
+    options optionally tunes how the job runs (see JobOptions).
+    The job runs on threads of its own, the function returns right away with
+    a JobHandle that can be used to interact with the running job.
 */
 JobHandle startMapReduceJob(const MapReduceClient &client,
                             const InputVec &inputVec, OutputVec &outputVec,
-                            int multiThreadLevel);
+                            int multiThreadLevel,
+                            const JobOptions &options = JobOptions());
+
+/*
+    Description: startMapReduceChain runs clients as a pipeline of jobs under
+    one JobHandle. The first client maps inputVec; every later client (a
+    ChainedMapReduceClient) maps the pairs the reduce of the one before it
+    emits, in the reducer thread that emits them, so the output of a job is
+    never collected in an OutputVec nor copied into a new InputVec. Only
+    the last client's output goes to outputVec. The jobs run on the same
+    number of worker threads, with the same arenas and key dictionary, and
+    options applies to each (sorted_output to the last). getJobState
+    reports the stage of the job of the chain that is running.
+*/
+JobHandle startMapReduceChain(const std::vector<const MapReduceClient *> &clients,
+                              const InputVec &inputVec, OutputVec &outputVec,
+                              int multiThreadLevel,
+                              const JobOptions &options = JobOptions());
+
+/*
+    Description: startMapOnlyJob runs a job that only maps, for filters and
+    transforms that have nothing to group. client's map emits its output
+    straight with emit3 (emit2 is an error), each map thread appends it to
+    a buffer of its own and the buffers are appended to outputVec once the
+    map threads are done; there is no sort, shuffle or reduce, and the
+    client's reduce is never called. The output comes in no particular
+    order. Of options, affinity, max_threads and deadline_ms apply. A
+    cancelled job keeps the output of the records mapped before it stopped.
+    The job otherwise behaves as one started by startMapReduceJob and
+    finishes in REDUCE_STAGE at 100%.
+*/
+JobHandle startMapOnlyJob(const MapReduceClient &client,
+                          const InputVec &inputVec, OutputVec &outputVec,
+                          int multiThreadLevel,
+                          const JobOptions &options = JobOptions());
+
+/*
+    Description: startAggregateJob runs a map-only job (see startMapOnlyJob)
+    that reduces its whole input to one value, such as a count or a sum.
+    Each map thread starts with an accumulator from client.init() that its
+    map folds values into with emitAggregate. A thread that is done merges
+    the accumulators of the threads it waits for in a binary tree (thread
+    i takes i + 1, i + 2, i + 4, ... for as long as i is a multiple of
+    twice the step), so the merges run in parallel and overlap the map
+    threads still running. The job then appends
+    (client.aggregateKey(), aggregate) to outputVec. A cancelled job
+    deletes its aggregate and appends nothing.
+*/
+JobHandle startAggregateJob(const AggregateMapReduceClient &client,
+                            const InputVec &inputVec, OutputVec &outputVec,
+                            int multiThreadLevel,
+                            const JobOptions &options = JobOptions());
 
 /*
     Description: waitForJob is a function that blocks the execution until the
@@ -67,6 +302,50 @@ JobHandle startMapReduceJob(const MapReduceClient &client,
 */
 void waitForJob(JobHandle job);
 
+/*
+    Description: waitForJobTimeout is waitForJob giving up after timeout_ms
+    milliseconds. The caller sleeps on a condition variable the job signals
+    when it completes, there is no polling. Returns true if the job
+    completed (finished or cancelled), false on timeout.
+*/
+bool waitForJobTimeout(JobHandle job, int64_t timeout_ms);
+
+/*
+    Description: job_callback_t is called once a job completes, with the
+    job's handle and the arg it was registered with.
+*/
+typedef void (*job_callback_t)(JobHandle job, void *arg);
+
+/*
+    Description: setJobCallback registers callback to run when the job
+    completes, replacing any callback registered before. It runs on the
+    job's own thread once getJobState reports the final stage, or right away
+    on the calling thread if the job has already completed. The callback may
+    read the output and the job state but must not wait for or close the
+    job.
+*/
+void setJobCallback(JobHandle job, job_callback_t callback, void *arg);
+
+/*
+    Description: getJobEventFd returns an eventfd that becomes readable when
+    the job completes, for event loops that poll or epoll their file
+    descriptors. It is created on the first call, belongs to the job and is
+    closed by closeJobHandle. Returns -1 if the eventfd can't be created.
+*/
+int getJobEventFd(JobHandle job);
+
+/*
+    Description: cancelJob asks the job to stop and returns without waiting
+    for it; waitForJob waits until it has. Workers notice the request
+    between map records and between reduce groups (the parts of a split
+    group that were already queued are still reduced), drop the
+    intermediate pairs that weren't reduced (see MapReduceClient::discard)
+    and free the job's buffers. outputVec keeps the output of the groups
+    reduced before, and getJobState reports CANCELLED_STAGE. Cancelling a
+    job that already finished does nothing.
+*/
+void cancelJob(JobHandle job);
+
 /*
     Description: getJobState is a function that retrieves the current state of the
     specified MapReduce job (job) and stores it in the provided JobState structure
@@ -78,10 +357,21 @@ void getJobState(JobHandle job, JobState *state);
 /*
     Description: closeJobHandle is a function used to release system resources
     associated with the specified MapReduce job handle (job). It is called when
-    you are done with the job and want to clean up any allocated resources.
+    you are done with the job and want to clean up any allocated resources,
+    including every object allocated with emitAlloc. The handle is invalid
+    afterwards.
 */
 void closeJobHandle(JobHandle job);
 
+/*
+    Description: setJobLogPath enables the job log and appends it to the file at
+    path, or disables it when path is nullptr. Workers push fixed-size records
+    to a lock-free queue and a background thread formats and writes them in
+    batches, so the log can stay on without disturbing the job's timing.
+    Returns false if the file can't be opened.
+*/
+bool setJobLogPath(const char *path);
+
 /*
  * shuffle phase function:
 1.Create a queue to store the new sequences of (k2, v2) where all keys are identical
@@ -107,5 +397,6 @@ void closeJobHandle(JobHandle job);
 
 Note: To ensure thread safety, appropriate synchronization mechanisms such as mutex
 locks and semaphores should be used when accessing shared resources such as the queue and atomic counter.
+*/
 
 #endif //MAPREDUCEFRAMEWORK_H
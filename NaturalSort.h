@@ -0,0 +1,108 @@
+#ifndef NATURALSORT_H
+#define NATURALSORT_H
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+// runs shorter than this are extended with an insertion sort before merging
+#define NATURAL_MIN_RUN 32
+
+// merges the sorted ranges [first, middle) and [middle, last) in place. The
+// elements of the left range that already precede the right one and those
+// of the right range that already follow the left one are found by binary
+// search and left where they are; only the left range's remaining elements
+// are copied out to buffer
+template<typename RandomIt, typename Less>
+void naturalMerge(RandomIt first, RandomIt middle, RandomIt last, Less less,
+                  std::vector<typename std::iterator_traits<RandomIt>::value_type>
+                  &buffer) {
+    first = std::upper_bound(first, middle, *middle, less);
+    last = std::lower_bound(middle, last, *(middle - 1), less);
+    if (first == middle || middle == last) {
+        return;
+    }
+    buffer.assign(first, middle);
+    auto left = buffer.begin();
+    RandomIt right = middle;
+    RandomIt out = first;
+    // out never passes right: it is behind by what is left in buffer
+    while (left != buffer.end() && right != last) {
+        if (less(*right, *left)) {
+            *out++ = *right++;
+        } else {
+            *out++ = *left++;
+        }
+    }
+    std::copy(left, buffer.end(), out);
+}
+
+/*
+    Description: naturalSort sorts [first, last) by less, stably, in time
+    that adapts to the order already there: it splits the range into its
+    ascending runs (strictly descending runs are reversed), extends runs
+    shorter than NATURAL_MIN_RUN with an insertion sort, and merges
+    neighbouring runs pairwise until one is left, skipping the parts of two
+    runs that are already in order. A sorted or reverse sorted range takes
+    one pass of n - 1 comparisons, a range made of k sorted runs about
+    n log k. On random input it is a merge sort, with fewer comparisons
+    than std::sort, which pays off when comparing is a virtual call.
+*/
+template<typename RandomIt, typename Less>
+void naturalSort(RandomIt first, RandomIt last, Less less) {
+    typedef typename std::iterator_traits<RandomIt>::difference_type Distance;
+    Distance size = last - first;
+    if (size < 2) {
+        return;
+    }
+
+    // the start of every run, and last
+    std::vector<Distance> bounds;
+    Distance begin = 0;
+    while (begin < size) {
+        Distance end = begin + 1;
+        if (end < size && less(first[end], first[end - 1])) {
+            while (end < size && less(first[end], first[end - 1])) {
+                end++;
+            }
+            std::reverse(first + begin, first + end);
+        } else {
+            while (end < size && not less(first[end], first[end - 1])) {
+                end++;
+            }
+        }
+        if (end - begin < NATURAL_MIN_RUN && end < size) {
+            // insertion sort the following elements into the run
+            Distance min_end = std::min<Distance>(begin + NATURAL_MIN_RUN, size);
+            for (; end < min_end; end++) {
+                auto value = first[end];
+                RandomIt position = std::upper_bound(first + begin, first + end,
+                                                     value, less);
+                std::move_backward(position, first + end, first + end + 1);
+                *position = value;
+            }
+        }
+        bounds.push_back(begin);
+        begin = end;
+    }
+    bounds.push_back(size);
+
+    std::vector<typename std::iterator_traits<RandomIt>::value_type> buffer;
+    while (bounds.size() > 2) {
+        size_t merged = 0;
+        size_t i = 0;
+        for (; i + 2 < bounds.size(); i += 2) {
+            naturalMerge(first + bounds[i], first + bounds[i + 1],
+                         first + bounds[i + 2], less, buffer);
+            bounds[merged++] = bounds[i];
+        }
+        // an odd run out waits for the next pass
+        if (i + 1 < bounds.size()) {
+            bounds[merged++] = bounds[i];
+        }
+        bounds[merged++] = size;
+        bounds.resize(merged);
+    }
+}
+
+#endif //NATURALSORT_H
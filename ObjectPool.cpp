@@ -0,0 +1,155 @@
+#include "ObjectPool.h"
+#include <pthread.h>
+#include <cstdlib>
+#include <new>
+
+// ******************************************************************
+// ********************** constants & structs ***********************
+// ******************************************************************
+
+#define POOL_GRANULARITY 16
+#define POOL_CLASSES (POOL_MAX_OBJECT / POOL_GRANULARITY)
+#define POOL_CHUNK_SIZE (64 * 1024)
+// objects moved between a thread cache and the central lists at once
+#define POOL_BATCH 32
+// a thread cache holding more than this gives a batch back
+#define POOL_CACHE_LIMIT (2 * POOL_BATCH)
+
+// a free object, linked through its first word
+typedef struct FreeObject {
+    FreeObject *next;
+} FreeObject;
+
+typedef struct FreeList {
+    FreeObject *head;
+    int count;
+} FreeList;
+
+// shared by all threads, one per size class; chunks are never returned
+typedef struct CentralList {
+    pthread_mutex_t mutex;
+    FreeList list;
+} CentralList;
+
+static CentralList central[POOL_CLASSES];
+static pthread_once_t central_once = PTHREAD_ONCE_INIT;
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+static void initCentral() {
+    for (int i = 0; i < POOL_CLASSES; ++i) {
+        pthread_mutex_init(&central[i].mutex, NULL);
+        central[i].list = {nullptr, 0};
+    }
+}
+
+static int sizeClass(size_t size) {
+    return size == 0 ? 0 : (int) ((size - 1) / POOL_GRANULARITY);
+}
+
+static void push(FreeList &list, void *object) {
+    FreeObject *free_object = (FreeObject *) object;
+    free_object->next = list.head;
+    list.head = free_object;
+    list.count++;
+}
+
+static void *pop(FreeList &list) {
+    FreeObject *free_object = list.head;
+    list.head = free_object->next;
+    list.count--;
+    return free_object;
+}
+
+// moves up to count objects from one list to the other
+static void transfer(FreeList &from, FreeList &to, int count) {
+    while (count-- > 0 && from.head != nullptr) {
+        push(to, pop(from));
+    }
+}
+
+// per-thread cache; flushed to the central lists when the thread exits so
+// objects freed by short-lived reduce threads are reused by later jobs
+class ThreadCache {
+public:
+    FreeList lists[POOL_CLASSES];
+
+    ThreadCache() {
+        pthread_once(&central_once, initCentral);
+        for (int i = 0; i < POOL_CLASSES; ++i) {
+            lists[i] = {nullptr, 0};
+        }
+    }
+
+    ~ThreadCache() {
+        for (int i = 0; i < POOL_CLASSES; ++i) {
+            pthread_mutex_lock(&central[i].mutex);
+            transfer(lists[i], central[i].list, lists[i].count);
+            pthread_mutex_unlock(&central[i].mutex);
+        }
+    }
+};
+
+static thread_local ThreadCache cache;
+
+// fills an empty thread list from the central list, or from a new chunk
+static void refill(int size_class) {
+    FreeList &list = cache.lists[size_class];
+    pthread_mutex_lock(&central[size_class].mutex);
+    transfer(central[size_class].list, list, POOL_BATCH);
+    pthread_mutex_unlock(&central[size_class].mutex);
+    if (list.head != nullptr) {
+        return;
+    }
+
+    size_t object_size = (size_class + 1) * POOL_GRANULARITY;
+    char *chunk = (char *) malloc(POOL_CHUNK_SIZE);
+    if (chunk == nullptr) {
+        throw std::bad_alloc();
+    }
+    for (size_t offset = 0; offset + object_size <= POOL_CHUNK_SIZE;
+         offset += object_size) {
+        push(list, chunk + offset);
+    }
+}
+
+// ******************************************************************
+// *********************** Pool functions ***************************
+// ******************************************************************
+
+void *poolAllocate(size_t size) {
+    if (size > POOL_MAX_OBJECT) {
+        void *object = malloc(size);
+        if (object == nullptr) {
+            throw std::bad_alloc();
+        }
+        return object;
+    }
+    int size_class = sizeClass(size);
+    if (cache.lists[size_class].head == nullptr) {
+        refill(size_class);
+    }
+    return pop(cache.lists[size_class]);
+}
+
+void poolFree(void *object, size_t size) {
+    if (object == nullptr) {
+        return;
+    }
+    if (size > POOL_MAX_OBJECT) {
+        free(object);
+        return;
+    }
+    int size_class = sizeClass(size);
+    FreeList &list = cache.lists[size_class];
+    // the batch goes back before the push, so the object just freed (still
+    // in this cpu's cache) is the next one its class hands out
+    if (list.count >= POOL_CACHE_LIMIT) {
+        pthread_mutex_lock(&central[size_class].mutex);
+        transfer(list, central[size_class].list, POOL_BATCH);
+        pthread_mutex_unlock(&central[size_class].mutex);
+    }
+    push(list, object);
+}
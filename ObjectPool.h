@@ -0,0 +1,46 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <cstddef>
+
+#define POOL_MAX_OBJECT 256
+
+/*
+    Description: poolAllocate returns size bytes from the framework's
+    small-object pool. Objects up to POOL_MAX_OBJECT bytes are served from a
+    per-thread cache of free objects of their size class, so reduce threads
+    allocating K3/V3 objects don't contend on malloc. Larger sizes fall back
+    to malloc. Throws std::bad_alloc if the system is out of memory.
+*/
+void *poolAllocate(size_t size);
+
+/*
+    Description: poolFree returns an object of the given size (the size it
+    was allocated with) to the calling thread's cache. Any thread may free
+    an object allocated by any other thread.
+*/
+void poolFree(void *object, size_t size);
+
+/*
+    Description: PoolObject is a mixin that makes new and delete of a class
+    go through the small-object pool. Inherit it in K3/V3 types and keep
+    using plain new in reduce and delete on the output; with a virtual
+    destructor delete passes the most derived size, so deleting through a
+    K3* or V3* returns the object to the right size class.
+*/
+class PoolObject {
+public:
+    static void *operator new(size_t size) {
+        return poolAllocate(size);
+    }
+
+    static void *operator new(size_t, void *where) {
+        return where;
+    }
+
+    static void operator delete(void *object, size_t size) {
+        poolFree(object, size);
+    }
+};
+
+#endif //OBJECTPOOL_H
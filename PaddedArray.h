@@ -0,0 +1,62 @@
+#ifndef PADDEDARRAY_H
+#define PADDEDARRAY_H
+
+#include <cstdlib>
+#include <new>
+
+#define CACHE_LINE 64
+
+/*
+    Description: PaddedArray is a fixed-size array whose elements each start
+    on their own cache line and are padded to a whole number of lines. It is
+    used for per-thread state that a single worker writes to, so two workers
+    never share (and bounce) a cache line. The storage is allocated with
+    posix_memalign since operator new ignores over-alignment before C++17.
+*/
+template<typename T>
+class PaddedArray {
+public:
+    explicit PaddedArray(size_t size) : slots(nullptr), count(size) {
+        void *memory = nullptr;
+        if (posix_memalign(&memory, CACHE_LINE, count * sizeof(Slot)) != 0) {
+            throw std::bad_alloc();
+        }
+        slots = static_cast<Slot *>(memory);
+        for (size_t i = 0; i < count; ++i) {
+            new(&slots[i]) Slot();
+        }
+    }
+
+    ~PaddedArray() {
+        for (size_t i = 0; i < count; ++i) {
+            slots[i].~Slot();
+        }
+        free(slots);
+    }
+
+    PaddedArray(const PaddedArray &) = delete;
+
+    PaddedArray &operator=(const PaddedArray &) = delete;
+
+    T &operator[](size_t i) {
+        return slots[i].value;
+    }
+
+    const T &operator[](size_t i) const {
+        return slots[i].value;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+private:
+    struct alignas(CACHE_LINE) Slot {
+        T value;
+    };
+
+    Slot *slots;
+    size_t count;
+};
+
+#endif //PADDEDARRAY_H
@@ -0,0 +1,50 @@
+#include "ParallelSort.h"
+
+SortTask::SortTask(size_t size, int leaves)
+        : leaves(leaves), next_leaf(0), size(size), leaf_nodes(leaves),
+          pending(2 * leaves) {
+    nodes.reserve(2 * leaves);
+    addNode(0, leaves, -1);
+}
+
+int SortTask::addNode(int first_leaf, int last_leaf, int parent) {
+    int node = (int) nodes.size();
+    nodes.push_back({first_leaf, last_leaf, parent});
+    if (last_leaf - first_leaf == 1) {
+        leaf_nodes[first_leaf] = node;
+        pending[node].store(0, std::memory_order_relaxed);
+        return node;
+    }
+    pending[node].store(2, std::memory_order_relaxed);
+    int middle = (first_leaf + last_leaf) / 2;
+    addNode(first_leaf, middle, node);
+    addNode(middle, last_leaf, node);
+    return node;
+}
+
+size_t SortTask::leafBegin(int leaf) const {
+    return size * leaf / leaves;
+}
+
+bool SortTask::runLeaf(int leaf, bool skip) {
+    int node = leaf_nodes[leaf];
+    if (not skip) {
+        sortRange(leafBegin(leaf), leafBegin(leaf + 1));
+    }
+    while (nodes[node].parent >= 0) {
+        int parent = nodes[node].parent;
+        // the first of two siblings leaves the merge to the second, which
+        // sees its sorted range through the acq_rel decrement
+        if (pending[parent].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return false;
+        }
+        const Node &merged = nodes[parent];
+        if (not skip) {
+            int middle = (merged.first_leaf + merged.last_leaf) / 2;
+            mergeRanges(leafBegin(merged.first_leaf), leafBegin(middle),
+                        leafBegin(merged.last_leaf));
+        }
+        node = parent;
+    }
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef PARALLELSORT_H
+#define PARALLELSORT_H
+
+#include "NaturalSort.h"
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+/*
+    Description: SortTask is the sort of one large range cut into leaves
+    consecutive parts, for several threads to share. Each leaf is sorted on
+    its own by whichever thread runs it; the parts form a binary tree and
+    the thread that completes the second of two sibling ranges merges them,
+    so the merges move up the tree without anyone waiting for them, and the
+    thread that merges the root has sorted the whole range. Handing out the
+    leaves is up to the caller: every leaf must be run exactly once.
+*/
+class SortTask {
+public:
+    SortTask(size_t size, int leaves);
+
+    virtual ~SortTask() {}
+
+    SortTask(const SortTask &) = delete;
+
+    SortTask &operator=(const SortTask &) = delete;
+
+    /*
+        Description: runLeaf sorts leaf and the merges it completes. With
+        skip the work is left out but the tree is still completed (for a
+        cancelled job). Returns true for the run that completed the root,
+        after which the task may be deleted.
+    */
+    bool runLeaf(int leaf, bool skip);
+
+    const int leaves;
+
+    // the next leaf to hand out, for the caller to use
+    int next_leaf;
+
+protected:
+    virtual void sortRange(size_t begin, size_t end) = 0;
+
+    virtual void mergeRanges(size_t begin, size_t middle, size_t end) = 0;
+
+private:
+    // a node covers leaves [first_leaf, last_leaf), split at their middle
+    typedef struct Node {
+        int first_leaf;
+        int last_leaf;
+        int parent;
+    } Node;
+
+    int addNode(int first_leaf, int last_leaf, int parent);
+
+    size_t leafBegin(int leaf) const;
+
+    size_t size;
+    std::vector<Node> nodes;
+    std::vector<int> leaf_nodes;
+    // children of every node still to complete
+    std::vector<std::atomic<int>> pending;
+};
+
+// a SortTask on [first, first + size) with naturalSort and its merge
+template<typename RandomIt, typename Less>
+class RangeSortTask : public SortTask {
+public:
+    RangeSortTask(RandomIt first, size_t size, int leaves, Less less)
+            : SortTask(size, leaves), first(first), less(less) {}
+
+protected:
+    virtual void sortRange(size_t begin, size_t end) {
+        naturalSort(first + begin, first + end, less);
+    }
+
+    virtual void mergeRanges(size_t begin, size_t middle, size_t end) {
+        if (begin == middle || middle == end) {
+            return;
+        }
+        std::vector<typename std::iterator_traits<RandomIt>::value_type> buffer;
+        naturalMerge(first + begin, first + middle, first + end, less, buffer);
+    }
+
+private:
+    RandomIt first;
+    Less less;
+};
+
+#endif //PARALLELSORT_H
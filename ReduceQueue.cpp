@@ -0,0 +1,60 @@
+#include "ReduceQueue.h"
+#include <utility>
+
+ReduceQueue::ReduceQueue(size_t max_pairs)
+        : mutex(PTHREAD_MUTEX_INITIALIZER)
+        , not_empty(PTHREAD_COND_INITIALIZER)
+        , not_full(PTHREAD_COND_INITIALIZER)
+        , queued_pairs(0)
+        , max_pairs(max_pairs)
+        , closed(false)
+{ }
+
+ReduceQueue::~ReduceQueue() {
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&not_empty);
+    pthread_cond_destroy(&not_full);
+}
+
+size_t ReduceQueue::pairsOf(const ReduceTask &task) {
+    if (task.split != nullptr) {
+        return task.end - task.begin;
+    }
+    return task.pairs.size() + task.records.size();
+}
+
+void ReduceQueue::push(ReduceTask &task) {
+    size_t pairs = pairsOf(task);
+    pthread_mutex_lock(&mutex);
+    while (not tasks.empty() && queued_pairs + pairs > max_pairs) {
+        pthread_cond_wait(&not_full, &mutex);
+    }
+    tasks.push_back(std::move(task));
+    queued_pairs += pairs;
+    pthread_cond_signal(&not_empty);
+    pthread_mutex_unlock(&mutex);
+}
+
+bool ReduceQueue::pop(ReduceTask *task) {
+    pthread_mutex_lock(&mutex);
+    while (tasks.empty() && not closed) {
+        pthread_cond_wait(&not_empty, &mutex);
+    }
+    if (tasks.empty()) {
+        pthread_mutex_unlock(&mutex);
+        return false;
+    }
+    *task = std::move(tasks.front());
+    tasks.pop_front();
+    queued_pairs -= pairsOf(*task);
+    pthread_cond_signal(&not_full);
+    pthread_mutex_unlock(&mutex);
+    return true;
+}
+
+void ReduceQueue::close() {
+    pthread_mutex_lock(&mutex);
+    closed = true;
+    pthread_cond_broadcast(&not_empty);
+    pthread_mutex_unlock(&mutex);
+}
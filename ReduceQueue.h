@@ -0,0 +1,87 @@
+#ifndef REDUCEQUEUE_H
+#define REDUCEQUEUE_H
+
+#include "MapReduceClient.h"
+#include "CompactRecord.h"
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+// the state shared by the parts of a split group; the reducer finishing the
+// last part merges the partial outputs. The group is in pairs, or in
+// records for a CompactMapReduceClient (kept in record_bytes when they were
+// read from a compressed run)
+typedef struct SplitGroup {
+    int group;
+    IntermediateVec pairs;
+    RecordVec records;
+    std::vector<char> record_bytes;
+    std::atomic<int> parts_left;
+    std::vector<OutputVec> partials;
+} SplitGroup;
+
+// a unit of reduce work: the whole group number group (in pairs, or in
+// records for a CompactMapReduceClient, see SplitGroup), or the [begin, end)
+// part number part of a group that was split
+typedef struct ReduceTask {
+    int group;
+    IntermediateVec pairs;
+    RecordVec records;
+    std::vector<char> record_bytes;
+    SplitGroup *split;
+    size_t begin;
+    size_t end;
+    int part;
+} ReduceTask;
+
+/*
+    Description: ReduceQueue hands the groups the shuffle finalizes to the
+    reducers while the shuffle is still merging. It is bounded by the number
+    of pairs waiting in it: push blocks while max_pairs are queued, so a
+    shuffle running ahead of the reducers doesn't copy every group at once.
+    A task is always accepted into an empty queue, however large.
+*/
+class ReduceQueue {
+public:
+    explicit ReduceQueue(size_t max_pairs);
+
+    ~ReduceQueue();
+
+    ReduceQueue(const ReduceQueue &) = delete;
+
+    ReduceQueue &operator=(const ReduceQueue &) = delete;
+
+    /*
+        Description: push moves task into the queue, blocking while it is full.
+    */
+    void push(ReduceTask &task);
+
+    /*
+        Description: pop moves the oldest task into task, blocking until one
+        is available. Returns false once the queue is closed and empty.
+    */
+    bool pop(ReduceTask *task);
+
+    /*
+        Description: close tells the reducers that no more tasks will come.
+    */
+    void close();
+
+    /*
+        Description: pairsOf returns the number of intermediate pairs task
+        reduces, for a split group only those of its part.
+    */
+    static size_t pairsOf(const ReduceTask &task);
+
+private:
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    std::deque<ReduceTask> tasks;
+    size_t queued_pairs;
+    size_t max_pairs;
+    bool closed;
+};
+
+#endif //REDUCEQUEUE_H
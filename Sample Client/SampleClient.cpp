@@ -1,4 +1,6 @@
 #include "MapReduceFramework.h"
+#include "ObjectPool.h"
+#include "ByteHistogram.h"
 #include <cstdio>
 #include <string>
 #include <array>
@@ -11,7 +13,7 @@ public:
     std::string content;
 };
 
-class KChar : public K2, public K3 {
+class KChar : public K2, public K3, public PoolObject {
 public:
     KChar(char c) : c(c) {}
 
@@ -26,7 +28,7 @@ public:
     char c;
 };
 
-class VCount : public V2, public V3 {
+class VCount : public V2, public V3, public PoolObject {
 public:
     VCount(int count) : count(count) {}
 
@@ -37,20 +39,28 @@ public:
 class CounterClient : public MapReduceClient {
 public:
     void map(const K1 *key, const V1 *value, void *context) const {
-        std::array<int, 256> counts;
+        const std::string &content = static_cast<const VString *>(value)->content;
+        std::array<uint32_t, HISTOGRAM_BINS> counts;
         counts.fill(0);
-        for (const char &c: static_cast<const VString *>(value)->content) {
-            counts[(unsigned char) c]++;
+        byteHistogram((const unsigned char *) content.data(), content.size(),
+                      counts.data());
+
+        size_t bins = 0;
+        for (int i = 0; i < HISTOGRAM_BINS; ++i) {
+            bins += counts[i] != 0;
         }
 
-        for (int i = 0; i < 256; ++i) {
+        // one slot per byte value that occurs, filled in place
+        IntermediatePair *pairs = emit2Reserve(bins, context);
+        for (int i = 0; i < HISTOGRAM_BINS; ++i) {
             if (counts[i] == 0)
                 continue;
 
-            KChar *k2 = new KChar(i);
-            VCount *v2 = new VCount(counts[i]);
+            // freed with the job by closeJobHandle, reduce doesn't delete them
+            KChar *k2 = emitAlloc<KChar>(context, i);
+            VCount *v2 = emitAlloc<VCount>(context, counts[i]);
             usleep(150000);
-            emit2(k2, v2, context);
+            *pairs++ = IntermediatePair(k2, v2);
         }
     }
 
@@ -60,8 +70,6 @@ public:
         int count = 0;
         for (const IntermediatePair &pair: *pairs) {
             count += static_cast<const VCount *>(pair.second)->count;
-            delete pair.first;
-            delete pair.second;
         }
         KChar *k3 = new KChar(c);
         VCount *v3 = new VCount(count);
@@ -86,16 +94,17 @@ int main(int argc, char **argv) {
     JobHandle job = startMapReduceJob(client, inputVec, outputVec, 4);
     getJobState(job, &state);
 
-    while (state.stage != REDUCE_STAGE || state.percentage != 100.0) {
+    // sleeps until the job completes, waking every 100ms to report progress
+    while (not waitForJobTimeout(job, 100)) {
         if (last_state.stage != state.stage ||
             last_state.percentage != state.percentage) {
             printf("stage %d, %f%% \n",
                    state.stage, state.percentage);
         }
-        usleep(100000);
         last_state = state;
         getJobState(job, &state);
     }
+    getJobState(job, &state);
     printf("stage %d, %f%% \n",
            state.stage, state.percentage);
     printf("Done!\n");
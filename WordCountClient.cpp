@@ -0,0 +1,194 @@
+#include "WordCountClient.h"
+#include "WordTokenizer.h"
+#include <cstdint>
+#include <cstring>
+
+#define FIRST_TABLE_SIZE 1024
+
+// ******************************************************************
+// ********************** typedefs & structs ************************
+// ******************************************************************
+
+// the K2 of WordCountClient, a view of a word of the input text
+class WordKey : public K2 {
+public:
+    WordKey(const WordView &view) : view(view) {}
+
+    // the order of std::string: bytes compared as unsigned, then length
+    virtual bool operator<(const K2 &other) const {
+        const WordView &theirs = static_cast<const WordKey &>(other).view;
+        size_t length = view.length < theirs.length ? view.length : theirs.length;
+        int order = memcmp(view.data, theirs.data, length);
+        return order < 0 || (order == 0 && view.length < theirs.length);
+    }
+
+    WordView view;
+};
+
+class WordCount : public V2 {
+public:
+    WordCount(int count) : count(count) {}
+
+    int count;
+};
+
+template<>
+struct arena_skips_destructor<WordKey> : std::true_type {};
+
+template<>
+struct arena_skips_destructor<WordCount> : std::true_type {};
+
+// an open addressing table of the distinct words of a chunk and their
+// counts; clear only touches the slots that were used
+class WordTable {
+public:
+    WordTable() : slots(FIRST_TABLE_SIZE) {}
+
+    void add(const WordView &word) {
+        if (2 * (used.size() + 1) > slots.size()) {
+            grow();
+        }
+        uint64_t hash = hashWord(word);
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot &slot = slots[i];
+            if (slot.count == 0) {
+                slot = {hash, word, 1};
+                used.push_back(i);
+                return;
+            }
+            if (slot.hash == hash && slot.word.length == word.length
+                && memcmp(slot.word.data, word.data, word.length) == 0) {
+                slot.count++;
+                return;
+            }
+        }
+    }
+
+    template<typename F>
+    void forEach(F visit) const {
+        for (size_t i: used) {
+            visit(slots[i].word, slots[i].count);
+        }
+    }
+
+    void clear() {
+        for (size_t i: used) {
+            slots[i].count = 0;
+        }
+        used.clear();
+    }
+
+private:
+    typedef struct Slot {
+        uint64_t hash;
+        WordView word;
+        int count;
+    } Slot;
+
+    // FNV-1a
+    static uint64_t hashWord(const WordView &word) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < word.length; i++) {
+            hash = (hash ^ (unsigned char) word.data[i]) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        std::vector<size_t> old_used;
+        old_used.swap(used);
+        size_t mask = slots.size() - 1;
+        for (size_t index: old_used) {
+            const Slot &slot = old[index];
+            size_t i = slot.hash & mask;
+            while (slots[i].count != 0) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+            used.push_back(i);
+        }
+    }
+
+    std::vector<Slot> slots;
+    std::vector<size_t> used;
+};
+
+// ******************************************************************
+// *********************** client functions *************************
+// ******************************************************************
+
+void WordCountClient::map(const K1 *key, const V1 *value, void *context) const {
+    (void) key;
+    // reused by every chunk this thread maps, so a chunk allocates nothing
+    // once the table is large enough
+    thread_local std::vector<WordView> words;
+    thread_local WordTable table;
+
+    const TextChunk *chunk = static_cast<const TextChunk *>(value);
+    words.clear();
+    tokenizeWords(chunk->data, chunk->size, &words);
+    for (const WordView &word: words) {
+        table.add(word);
+    }
+    bool intern = intern_keys;
+    table.forEach([context, intern](const WordView &word, int count) {
+        K2 *k2 = intern ? (K2 *) emitInternedKey(word.data, word.length, context)
+                        : (K2 *) emitAlloc<WordKey>(context, word);
+        emit2(k2, emitAlloc<WordCount>(context, count), context);
+    });
+    table.clear();
+}
+
+void WordCountClient::reduce(const IntermediateVec *pairs, void *context) const {
+    int count = 0;
+    for (const IntermediatePair &pair: *pairs) {
+        count += static_cast<const WordCount *>(pair.second)->count;
+    }
+    const K2 *key = pairs->at(0).first;
+    if (intern_keys) {
+        const std::string &word = internedKeyString(
+                static_cast<const InternedKey *>(key)->id, context);
+        emit3(new OutputWord(word.data(), word.size()), new WordFrequency(count),
+              context);
+        return;
+    }
+    const WordView &word = static_cast<const WordKey *>(key)->view;
+    emit3(new OutputWord(word.data, word.length), new WordFrequency(count),
+          context);
+}
+
+bool WordCountClient::ranksBefore(const OutputPair &pair1,
+                                  const OutputPair &pair2) const {
+    int count1 = static_cast<const WordFrequency *>(pair1.second)->count;
+    int count2 = static_cast<const WordFrequency *>(pair2.second)->count;
+    if (count1 != count2) {
+        return count1 > count2;
+    }
+    return *pair1.first < *pair2.first;
+}
+
+bool WordCountClient::estimateMapCosts(const InputVec &input,
+                                       std::vector<double> *costs) const {
+    costs->reserve(input.size());
+    for (const InputPair &pair: input) {
+        costs->push_back((double) static_cast<const TextChunk *>(pair.second)->size);
+    }
+    return true;
+}
+
+void splitText(const char *text, size_t size, size_t chunk_size,
+               std::vector<TextChunk> *chunks) {
+    size_t begin = 0;
+    while (begin < size) {
+        size_t end = size - begin > chunk_size ? begin + chunk_size : size;
+        // move the cut past the word it falls in
+        while (end < size && not isSpace((unsigned char) text[end])) {
+            end++;
+        }
+        chunks->emplace_back(text + begin, end - begin);
+        begin = end;
+    }
+}
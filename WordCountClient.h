@@ -0,0 +1,86 @@
+#ifndef WORDCOUNTCLIENT_H
+#define WORDCOUNTCLIENT_H
+
+#include "MapReduceFramework.h"
+#include "ObjectPool.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+    Description: TextChunk is the V1 of WordCountClient: a piece of a text
+    buffer (a line, a mmapped file or a part of one) that is not copied.
+    The buffer must outlive the job.
+*/
+class TextChunk : public V1 {
+public:
+    TextChunk(const char *data, size_t size) : data(data), size(size) {}
+
+    const char *data;
+    size_t size;
+};
+
+// the K3 of WordCountClient, it owns a copy of the word
+class OutputWord : public K3, public PoolObject {
+public:
+    OutputWord(const char *data, size_t length) : word(data, length) {}
+
+    virtual bool operator<(const K3 &other) const {
+        return word < static_cast<const OutputWord &>(other).word;
+    }
+
+    std::string word;
+};
+
+// the V3 of WordCountClient: the number of times its word appears
+class WordFrequency : public V3, public PoolObject {
+public:
+    WordFrequency(int count) : count(count) {}
+
+    int count;
+};
+
+/*
+    Description: WordCountClient is a ready-made word frequency client. map
+    splits its TextChunk with tokenizeWords and counts the words in a hash
+    table its thread reuses from chunk to chunk, then emits one pair per
+    distinct word of the chunk. The K2 words point into the chunk and, like
+    the counts, are allocated with emitAlloc, so nothing is copied or
+    deleted before reduce. reduce emits an OutputWord and a WordFrequency
+    the caller deletes. The output is what splitting the text with
+    operator>> into std::strings and counting them gives.
+    With intern_keys the K2 are InternedKeys instead: the job sorts and
+    groups word ids, which pays off when there are few distinct words
+    compared to the number of pairs.
+    The outputs rank by count, the most frequent first, then by word, so
+    with JobOptions::top_k the job outputs the most frequent words.
+    A chunk's map cost is estimated by its size, so chunks of very
+    different sizes are still split evenly between the map threads.
+*/
+class WordCountClient : public RankedMapReduceClient {
+public:
+    explicit WordCountClient(bool intern_keys = false) : intern_keys(intern_keys) {}
+
+    virtual void map(const K1 *key, const V1 *value, void *context) const;
+
+    virtual void reduce(const IntermediateVec *pairs, void *context) const;
+
+    virtual bool ranksBefore(const OutputPair &pair1,
+                             const OutputPair &pair2) const;
+
+    virtual bool estimateMapCosts(const InputVec &input,
+                                  std::vector<double> *costs) const;
+
+private:
+    bool intern_keys;
+};
+
+/*
+    Description: splitText cuts text[0, size) into chunks of about
+    chunk_size bytes, never inside a word, and appends them to chunks.
+    Larger chunks give map more repeated words to count at once.
+*/
+void splitText(const char *text, size_t size, size_t chunk_size,
+               std::vector<TextChunk> *chunks);
+
+#endif //WORDCOUNTCLIENT_H
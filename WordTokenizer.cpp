@@ -0,0 +1,114 @@
+#include "WordTokenizer.h"
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TOKENIZER_X86 1
+#endif
+
+// bytes classified per step, one bit of a mask each
+#define BLOCK_SIZE 64
+
+// sets bit i of the result when block[i] is whitespace
+typedef uint64_t (*classify_t)(const char *block);
+
+// ******************************************************************
+// *********************** helper functions *************************
+// ******************************************************************
+
+static uint64_t classifyScalar(const char *block) {
+    uint64_t mask = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        mask |= (uint64_t) isSpace((unsigned char) block[i]) << i;
+    }
+    return mask;
+}
+
+#ifdef TOKENIZER_X86
+
+// SSE2 is part of x86-64, this kernel needs no runtime check
+static uint64_t classifySse2(const char *block) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i range = _mm_set1_epi8('\r' - '\t');
+    uint64_t mask = 0;
+    for (int i = 0; i < BLOCK_SIZE; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) (block + i));
+        // byte - '\t' <= '\r' - '\t' as unsigned: min(x, range) == x
+        __m128i shifted = _mm_sub_epi8(bytes, tab);
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, range), shifted);
+        __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(bytes, space), control);
+        mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(spaces) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t classifyAvx2(const char *block) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i range = _mm256_set1_epi8('\r' - '\t');
+    uint64_t mask = 0;
+    for (int i = 0; i < BLOCK_SIZE; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *) (block + i));
+        __m256i shifted = _mm256_sub_epi8(bytes, tab);
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, range),
+                                            shifted);
+        __m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, space), control);
+        mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(spaces) << i;
+    }
+    return mask;
+}
+
+#endif
+
+static classify_t pickClassifier() {
+#ifdef TOKENIZER_X86
+    return __builtin_cpu_supports("avx2") ? classifyAvx2 : classifySse2;
+#else
+    return classifyScalar;
+#endif
+}
+
+// ******************************************************************
+// *********************** tokenizer functions **********************
+// ******************************************************************
+
+void tokenizeWords(const char *text, size_t size, std::vector<WordView> *words) {
+    static const classify_t classify = pickClassifier();
+
+    // a bit flips between whitespace and word at every word boundary;
+    // carry is the whitespace bit of the byte before the block, the text
+    // behaves as if it started and ended with whitespace
+    uint64_t carry = 1;
+    size_t word_start = 0;
+    for (size_t base = 0; base < size; base += BLOCK_SIZE) {
+        uint64_t spaces;
+        size_t left = size - base;
+        if (left >= BLOCK_SIZE) {
+            spaces = classify(text + base);
+        } else {
+            char tail[BLOCK_SIZE];
+            for (size_t i = 0; i < BLOCK_SIZE; i++) {
+                tail[i] = i < left ? text[base + i] : ' ';
+            }
+            spaces = classifyScalar(tail);
+        }
+
+        uint64_t boundaries = spaces ^ ((spaces << 1) | carry);
+        carry = spaces >> (BLOCK_SIZE - 1);
+        while (boundaries != 0) {
+            int bit = __builtin_ctzll(boundaries);
+            boundaries &= boundaries - 1;
+            size_t position = base + bit;
+            if ((spaces >> bit) & 1) {
+                words->push_back({text + word_start, position - word_start});
+            } else {
+                word_start = position;
+            }
+        }
+    }
+    if (carry == 0) {
+        words->push_back({text + word_start, size - word_start});
+    }
+}
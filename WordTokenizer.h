@@ -0,0 +1,33 @@
+#ifndef WORDTOKENIZER_H
+#define WORDTOKENIZER_H
+
+#include <cstddef>
+#include <vector>
+
+// a word of a text buffer, it points into the buffer and isn't terminated
+typedef struct WordView {
+    const char *data;
+    size_t length;
+} WordView;
+
+/*
+    Description: isSpace tells whether byte separates words: the bytes
+    std::isspace accepts in the "C" locale (space, \t, \n, \v, \f and \r).
+    Everything that cuts text at word boundaries uses it, so the cuts agree
+    with tokenizeWords.
+*/
+inline bool isSpace(unsigned char byte) {
+    return byte == ' ' || (unsigned char) (byte - '\t') <= '\r' - '\t';
+}
+
+/*
+    Description: tokenizeWords appends a view of every word of text[0, size)
+    to words. Words are separated by the bytes isSpace accepts, the same
+    words reading the text with operator>> into a std::string gives,
+    without copying them. The bytes are classified 64 at a time with SSE2,
+    or AVX2 when the cpu supports it, and word boundaries are found from the
+    resulting bit masks.
+*/
+void tokenizeWords(const char *text, size_t size, std::vector<WordView> *words);
+
+#endif //WORDTOKENIZER_H
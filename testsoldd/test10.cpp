@@ -0,0 +1,105 @@
+/**
+ * JobOptions::top_k: WordCountClient's top words of the files of test4 are
+ * the first lines of their expected output, and asking for more words than
+ * there are gives the whole expected output.
+ * Run it from testsoldd, or pass the directory of the text files.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include "../WordCountClient.h"
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define FILES 4
+#define THREADS 4
+#define CHUNK_SIZE 256
+
+using namespace std;
+
+std::string readFile (const std::string &path)
+{
+  std::ifstream ifs (path);
+  if (!ifs.is_open ())
+  {
+    std::cout << "ERROR: can't open " << path << std::endl;
+    exit (EXIT_FAILURE);
+  }
+  std::stringstream contents;
+  contents << ifs.rdbuf ();
+  return contents.str ();
+}
+
+// the first lines of the expected output, all of them for lines == 0
+std::vector<std::string> expectedLines (const std::string &path, size_t lines)
+{
+  std::ifstream ifs (path);
+  std::vector<std::string> expected;
+  std::string line;
+  while (std::getline (ifs, line) && (lines == 0 || expected.size () < lines))
+  {
+    expected.push_back (line);
+  }
+  return expected;
+}
+
+void checkTop (const std::string &text, const std::string &expected_path,
+               size_t top_k, size_t lines)
+{
+  std::vector<TextChunk> chunks;
+  splitText (text.data (), text.size (), CHUNK_SIZE, &chunks);
+  InputVec input;
+  for (TextChunk &chunk : chunks)
+  {
+    input.push_back (make_pair (nullptr, &chunk));
+  }
+
+  WordCountClient client;
+  OutputVec results;
+  JobOptions options;
+  options.top_k = top_k;
+  JobHandle job = startMapReduceJob (client, input, results, THREADS, options);
+  waitForJob (job);
+  closeJobHandle (job);
+
+  std::vector<std::string> expected = expectedLines (expected_path, lines);
+  if (results.size () != expected.size ())
+  {
+    std::cout << "ERROR: EXPECTED " << expected.size () << " WORDS, GOT "
+              << results.size () << " FOR TOP " << top_k << std::endl;
+    exit (EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < results.size (); i++)
+  {
+    std::stringstream line;
+    line << '{' << ((OutputWord *) results[i].first)->word << " , "
+         << ((WordFrequency *) results[i].second)->count << "}";
+    if (line.str () != expected[i])
+    {
+      std::cout << "ERROR: WORD " << i << " OF TOP " << top_k << " IS "
+                << line.str () << ", EXPECTED " << expected[i] << std::endl;
+      exit (EXIT_FAILURE);
+    }
+    delete results[i].first;
+    delete results[i].second;
+  }
+}
+
+int main (int argc, char *argv[])
+{
+  std::string directory = argc > 1 ? argv[1] : "TextFiles";
+  for (int i = 1; i <= FILES; i++)
+  {
+    std::string path = directory + "/text_file_" + std::to_string (i);
+    std::string text = readFile (path + ".txt");
+    std::string expected_path = path + "_expected_output.txt";
+    checkTop (text, expected_path, 5, 5);
+    checkTop (text, expected_path, 1000000, 0);
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
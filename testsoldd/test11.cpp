@@ -0,0 +1,165 @@
+/**
+ * startMapOnlyJob: a prime filter maps straight to the output, reduce is
+ * never called, the job ends in REDUCE_STAGE at 100%, and a cancelled job
+ * keeps what it mapped before it stopped.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#define N 200000
+#define THREADS 4
+
+using namespace std;
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {}
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+bool isPrime (int n)
+{
+  if (n < 2)
+  {
+    return false;
+  }
+  for (int d = 2; d * d <= n; d++)
+  {
+    if (n % d == 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// (n) -> (n, nullptr) for every prime n
+struct MRPrimes : public MapReduceClient {
+    useconds_t map_sleep;
+
+    MRPrimes (useconds_t map_sleep) : map_sleep (map_sleep)
+    {}
+
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      // usleep (0) is still a syscall, too slow for every record
+      if (map_sleep > 0)
+      {
+        usleep (map_sleep);
+      }
+      int n = ((const Number *) key)->n;
+      if (isPrime (n))
+      {
+        emit3 (new Number (n), nullptr, context);
+      }
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      (void) pairs;
+      (void) context;
+      std::cout << "ERROR: A MAP-ONLY JOB REDUCED" << std::endl;
+      exit (EXIT_FAILURE);
+    }
+};
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+// the numbers of the output, sorted, after freeing it
+std::vector<int> takeOutput (OutputVec &results)
+{
+  std::vector<int> numbers;
+  for (OutputPair &pair : results)
+  {
+    expect (pair.second == nullptr, "WRONG OUTPUT VALUE");
+    numbers.push_back (((Number *) pair.first)->n);
+    delete pair.first;
+  }
+  results.clear ();
+  std::sort (numbers.begin (), numbers.end ());
+  return numbers;
+}
+
+int main ()
+{
+  InputVec numbers;
+  std::vector<int> primes;
+  for (int i = 0; i < N; ++i)
+  {
+    numbers.push_back (make_pair (new Number (i), nullptr));
+    if (isPrime (i))
+    {
+      primes.push_back (i);
+    }
+  }
+
+  MRPrimes fast (0);
+  for (int threads : {THREADS, 1, 0})
+  {
+    OutputVec results;
+    JobHandle job = startMapOnlyJob (fast, numbers, results, threads);
+    waitForJob (job);
+    JobState state;
+    getJobState (job, &state);
+    closeJobHandle (job);
+    expect (state.stage == REDUCE_STAGE && state.percentage == 100,
+            "A FINISHED JOB ISN'T IN REDUCE_STAGE AT 100%");
+    expect (takeOutput (results) == primes, "WRONG PRIMES");
+  }
+
+  // N * 100us over 4 threads takes five seconds to map
+  MRPrimes slow (100);
+  OutputVec results;
+  JobHandle job = startMapOnlyJob (slow, numbers, results, THREADS);
+  usleep (50000);
+  cancelJob (job);
+  waitForJob (job);
+  JobState state;
+  getJobState (job, &state);
+  closeJobHandle (job);
+  expect (state.stage == CANCELLED_STAGE, "CANCELLED JOB DIDN'T REPORT CANCELLED_STAGE");
+  std::vector<int> kept = takeOutput (results);
+  expect (not kept.empty () && kept.size () < primes.size (),
+          "CANCELLED JOB DIDN'T KEEP A PART OF ITS OUTPUT");
+  for (int n : kept)
+  {
+    expect (isPrime (n), "CANCELLED JOB KEPT A WRONG NUMBER");
+  }
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * startAggregateJob: the count and the sum of the primes below N come out
+ * as a single output pair with any number of threads, every accumulator
+ * but the one output is freed, and a cancelled job outputs nothing. A
+ * deadline that passes while the last records are mapped stops nothing and
+ * the aggregate is kept.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <iostream>
+
+#define N 200000
+#define THREADS 4
+
+using namespace std;
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {}
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+std::atomic<int> live_totals (0);
+
+struct Totals : public V3 {
+    long long count;
+    long long sum;
+
+    Totals () : count (0), sum (0)
+    {
+      live_totals++;
+    }
+
+    ~Totals ()
+    {
+      live_totals--;
+    }
+};
+
+bool isPrime (int n)
+{
+  if (n < 2)
+  {
+    return false;
+  }
+  for (int d = 2; d * d <= n; d++)
+  {
+    if (n % d == 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the count and the sum of the primes of the input
+struct MRPrimeTotals : public AggregateMapReduceClient {
+    useconds_t map_sleep;
+
+    MRPrimeTotals (useconds_t map_sleep) : map_sleep (map_sleep)
+    {}
+
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      // usleep (0) is still a syscall, too slow for every record
+      if (map_sleep > 0)
+      {
+        usleep (map_sleep);
+      }
+      const Number *number = (const Number *) key;
+      if (isPrime (number->n))
+      {
+        emitAggregate (number, context);
+      }
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      (void) pairs;
+      (void) context;
+      std::cout << "ERROR: AN AGGREGATE JOB REDUCED" << std::endl;
+      exit (EXIT_FAILURE);
+    }
+
+    virtual V3 *init () const override
+    {
+      return new Totals ();
+    }
+
+    virtual void accumulate (V3 *accumulator, const V2 *value) const override
+    {
+      Totals *totals = (Totals *) accumulator;
+      totals->count++;
+      totals->sum += ((const Number *) value)->n;
+    }
+
+    virtual void merge (V3 *accumulator, V3 *other) const override
+    {
+      Totals *totals = (Totals *) accumulator;
+      totals->count += ((Totals *) other)->count;
+      totals->sum += ((Totals *) other)->sum;
+      delete other;
+    }
+
+    virtual K3 *aggregateKey () const override
+    {
+      return new Number (N);
+    }
+};
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+int main ()
+{
+  InputVec numbers;
+  long long count = 0;
+  long long sum = 0;
+  for (int i = 0; i < N; ++i)
+  {
+    numbers.push_back (make_pair (new Number (i), nullptr));
+    if (isPrime (i))
+    {
+      count++;
+      sum += i;
+    }
+  }
+
+  MRPrimeTotals fast (0);
+  for (int threads : {THREADS, 7, 1, 0})
+  {
+    OutputVec results;
+    JobHandle job = startAggregateJob (fast, numbers, results, threads);
+    waitForJob (job);
+    JobState state;
+    getJobState (job, &state);
+    closeJobHandle (job);
+    expect (state.stage == REDUCE_STAGE && state.percentage == 100,
+            "A FINISHED JOB ISN'T IN REDUCE_STAGE AT 100%");
+    expect (results.size () == 1, "NOT A SINGLE OUTPUT PAIR");
+    expect (live_totals == 1, "AN ACCUMULATOR WASN'T MERGED AND FREED");
+    Totals *totals = (Totals *) results[0].second;
+    expect (((Number *) results[0].first)->n == N, "WRONG AGGREGATE KEY");
+    expect (totals->count == count && totals->sum == sum, "WRONG TOTALS");
+    delete results[0].first;
+    delete results[0].second;
+  }
+
+  // N * 100us over 4 threads takes five seconds to map
+  MRPrimeTotals slow (100);
+  OutputVec results;
+  JobHandle job = startAggregateJob (slow, numbers, results, THREADS);
+  usleep (50000);
+  cancelJob (job);
+  waitForJob (job);
+  JobState state;
+  getJobState (job, &state);
+  closeJobHandle (job);
+  expect (state.stage == CANCELLED_STAGE, "CANCELLED JOB DIDN'T REPORT CANCELLED_STAGE");
+  expect (results.empty (), "CANCELLED JOB OUTPUT AN AGGREGATE");
+  expect (live_totals == 0, "CANCELLED JOB DIDN'T FREE ITS ACCUMULATORS");
+
+  // one record per thread, each mapped for 300ms past the 100ms deadline
+  InputVec last_records (numbers.begin (), numbers.begin () + THREADS);
+  MRPrimeTotals slower (300000);
+  JobOptions deadline;
+  deadline.deadline_ms = 100;
+  job = startAggregateJob (slower, last_records, results, THREADS, deadline);
+  waitForJob (job);
+  getJobState (job, &state);
+  closeJobHandle (job);
+  expect (state.stage == REDUCE_STAGE, "A DEADLINE AFTER THE LAST RECORD CANCELLED THE JOB");
+  expect (results.size () == 1 && live_totals == 1,
+          "A DEADLINE AFTER THE LAST RECORD DROPPED THE AGGREGATE");
+  delete results[0].first;
+  delete results[0].second;
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,208 @@
+/**
+ * emit2Batch and emit2Reserve: a map that emits FAN_OUT pairs per record
+ * gives the same counts with emit2, with one emit2Batch, with the slots of
+ * emit2Reserve filled in place, and with emit2Batch of a
+ * CompactMapReduceClient.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+
+#define N 20000
+#define RANGE 300
+#define FAN_OUT 64
+#define THREADS 4
+
+using namespace std;
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n = 0) : n (n)
+    {}
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+template<>
+struct arena_skips_destructor<Number> : std::true_type {};
+
+enum emit_mode_t {
+    EMIT_PAIRS, EMIT_BATCH, EMIT_RESERVE
+};
+
+// (n) -> (n + j, 1) for j < FAN_OUT, counted by key
+struct MRFanOut : public MapReduceClient {
+    emit_mode_t mode;
+
+    MRFanOut (emit_mode_t mode) : mode (mode)
+    {}
+
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      int n = ((const Number *) key)->n;
+      IntermediatePair batch[FAN_OUT];
+      IntermediatePair *pairs = mode == EMIT_RESERVE
+                                ? emit2Reserve (FAN_OUT, context) : batch;
+      for (int j = 0; j < FAN_OUT; j++)
+      {
+        K2 *k2 = emitAlloc<Number> (context, n + j);
+        V2 *v2 = emitAlloc<Number> (context, 1);
+        if (mode == EMIT_PAIRS)
+        {
+          emit2 (k2, v2, context);
+        }
+        else
+        {
+          pairs[j] = IntermediatePair (k2, v2);
+        }
+      }
+      if (mode == EMIT_BATCH)
+      {
+        emit2Batch (batch, FAN_OUT, context);
+      }
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      int count = 0;
+      for (const IntermediatePair &pair : *pairs)
+      {
+        count += ((const Number *) pair.second)->n;
+      }
+      emit3 (new Number (((const Number *) pairs->at (0).first)->n),
+             new Number (count), context);
+    }
+};
+
+// the same job with its pairs as 4 byte records, emitted from the stack
+struct MRCompactFanOut : public CompactMapReduceClient {
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      int n = ((const Number *) key)->n;
+      Number keys[FAN_OUT];
+      Number one (1);
+      IntermediatePair batch[FAN_OUT];
+      for (int j = 0; j < FAN_OUT; j++)
+      {
+        keys[j].n = n + j;
+        batch[j] = IntermediatePair (&keys[j], &one);
+      }
+      emit2Batch (batch, FAN_OUT, context);
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      MRFanOut (EMIT_PAIRS).reduce (pairs, context);
+    }
+
+    virtual void serializeKey (const K2 *key, std::vector<char> *out) const override
+    {
+      int n = ((const Number *) key)->n;
+      out->push_back ((char) (n >> 8));
+      out->push_back ((char) n);
+    }
+
+    virtual void serializeValue (const V2 *value, std::vector<char> *out) const override
+    {
+      int n = ((const Number *) value)->n;
+      out->push_back ((char) (n >> 8));
+      out->push_back ((char) n);
+    }
+
+    virtual K2 *deserializeKey (const char *data, size_t size,
+                                void *context) const override
+    {
+      (void) size;
+      return emitAlloc<Number> (context, ((unsigned char) data[0] << 8)
+                                         | (unsigned char) data[1]);
+    }
+
+    virtual V2 *deserializeValue (const char *data, size_t size,
+                                  void *context) const override
+    {
+      (void) size;
+      return emitAlloc<Number> (context, ((unsigned char) data[0] << 8)
+                                         | (unsigned char) data[1]);
+    }
+};
+
+void checkJob (const MapReduceClient &client, const InputVec &numbers,
+               const std::map<int, int> &expectedOutput, const char *name)
+{
+  OutputVec results;
+  JobOptions options;
+  options.sorted_output = true;
+  JobHandle job = startMapReduceJob (client, numbers, results, THREADS, options);
+  waitForJob (job);
+  closeJobHandle (job);
+
+  if (results.size () != expectedOutput.size ())
+  {
+    std::cout << "ERROR: " << name << " EXPECTED " << expectedOutput.size ()
+              << " KEYS, GOT " << results.size () << std::endl;
+    exit (EXIT_FAILURE);
+  }
+  auto expected = expectedOutput.begin ();
+  for (OutputPair &pair : results)
+  {
+    int key = ((Number *) pair.first)->n;
+    int count = ((Number *) pair.second)->n;
+    if (key != expected->first || count != expected->second)
+    {
+      std::cout << "ERROR: " << name << " KEY " << key << " COUNTED " << count
+                << ", EXPECTED KEY " << expected->first << " COUNTED "
+                << expected->second << std::endl;
+      exit (EXIT_FAILURE);
+    }
+    ++expected;
+    delete pair.first;
+    delete pair.second;
+  }
+}
+
+int main ()
+{
+  InputVec numbers;
+  std::map<int, int> expectedOutput;
+  srand (0);
+  for (int i = 0; i < N; ++i)
+  {
+    int n = std::rand () % RANGE;
+    numbers.push_back (make_pair (new Number (n), nullptr));
+    for (int j = 0; j < FAN_OUT; j++)
+    {
+      expectedOutput[n + j]++;
+    }
+  }
+
+  checkJob (MRFanOut (EMIT_PAIRS), numbers, expectedOutput, "EMIT2");
+  checkJob (MRFanOut (EMIT_BATCH), numbers, expectedOutput, "EMIT2BATCH");
+  checkJob (MRFanOut (EMIT_RESERVE), numbers, expectedOutput, "EMIT2RESERVE");
+  checkJob (MRCompactFanOut (), numbers, expectedOutput, "COMPACT EMIT2BATCH");
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * InputSplits: every worker starts at the front of its share (split by
+ * cost when costs are given), every record is handed out exactly once
+ * while workers steal from each other, and each worker gets its records
+ * in a few long runs of consecutive indices.
+ */
+#include "../InputSplits.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+#define N 1000000
+#define WORKERS 8
+#define MAX_JUMPS 1000
+
+using namespace std;
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+typedef struct Worker {
+    InputSplits *splits;
+    int id;
+    std::vector<std::atomic<int>> *taken;
+    // the records that didn't follow the one before
+    int jumps;
+} Worker;
+
+void *mapRecords (void *arg)
+{
+  Worker *worker = (Worker *) arg;
+  int last = -2;
+  for (int i = worker->splits->next (worker->id); i >= 0;
+       i = worker->splits->next (worker->id))
+  {
+    (*worker->taken)[i]++;
+    worker->jumps += i != last + 1;
+    last = i;
+  }
+  return nullptr;
+}
+
+int main ()
+{
+  // equal shares of 100 records
+  InputSplits equal (4, 0, 100, nullptr);
+  expect (equal.next (0) == 0 && equal.next (1) == 25 && equal.next (2) == 50
+          && equal.next (3) == 75, "EQUAL SHARES DON'T START AT i * 25");
+
+  // the first ten records cost 9, the others 1: 180 split in four is
+  // records [0, 5), [5, 10), [10, 55) and [55, 100)
+  std::vector<double> costs (100, 1);
+  for (int i = 0; i < 10; i++)
+  {
+    costs[i] = 9;
+  }
+  InputSplits weighted (4, 0, 100, &costs);
+  expect (weighted.next (0) == 0 && weighted.next (1) == 5
+          && weighted.next (2) == 10 && weighted.next (3) == 55,
+          "COSTED SHARES DON'T START WHERE THE COST IS SPLIT");
+
+  // a single worker steals every other range
+  InputSplits alone (WORKERS, 10, 1000, nullptr);
+  std::vector<char> seen (1000, 0);
+  for (int i = alone.next (0); i >= 0; i = alone.next (0))
+  {
+    expect (i >= 10 && not seen[i], "RECORD OUT OF RANGE OR HANDED OUT TWICE");
+    seen[i] = 1;
+  }
+  for (int i = 10; i < 1000; i++)
+  {
+    expect (seen[i], "A LONE WORKER DIDN'T GET EVERY RECORD");
+  }
+
+  // workers mapping at once
+  InputSplits splits (WORKERS, 0, N, nullptr);
+  std::vector<std::atomic<int>> taken (N);
+  for (std::atomic<int> &count : taken)
+  {
+    count = 0;
+  }
+  std::vector<Worker> workers (WORKERS);
+  std::vector<pthread_t> threads (WORKERS);
+  for (int i = 0; i < WORKERS; i++)
+  {
+    workers[i] = {&splits, i, &taken, 0};
+    pthread_create (&threads[i], NULL, mapRecords, &workers[i]);
+  }
+  int jumps = 0;
+  for (int i = 0; i < WORKERS; i++)
+  {
+    pthread_join (threads[i], NULL);
+    jumps += workers[i].jumps;
+  }
+  for (int i = 0; i < N; i++)
+  {
+    expect (taken[i] == 1, "A RECORD WASN'T HANDED OUT EXACTLY ONCE");
+  }
+  expect (jumps < MAX_JUMPS, "WORKERS DIDN'T GET CONTIGUOUS RUNS");
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
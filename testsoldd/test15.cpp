@@ -0,0 +1,79 @@
+/**
+ * naturalSort: on random, sorted, reverse sorted, nearly sorted, blocked
+ * and few-valued inputs of many sizes it gives what std::stable_sort does,
+ * so it sorts and keeps equal keys in their order.
+ */
+#include "../NaturalSort.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#define PATTERNS 6
+
+using namespace std;
+
+// a key and its position in the input, only the key is compared
+typedef std::pair<int, int> Item;
+
+bool keyLess (const Item &item1, const Item &item2)
+{
+  return item1.first < item2.first;
+}
+
+std::vector<Item> makeInput (int size, int pattern)
+{
+  std::vector<Item> items (size);
+  for (int i = 0; i < size; i++)
+  {
+    int key;
+    switch (pattern)
+    {
+      case 0:
+        key = std::rand ();
+        break;
+      case 1:
+        key = i;
+        break;
+      case 2:
+        key = size - i;
+        break;
+      case 3:
+        key = std::rand () % 20 == 0 ? std::rand () % (size + 1) : i;
+        break;
+      case 4:
+        // sorted blocks of 100, every block starting low again
+        key = i % 100 + std::rand () % 3;
+        break;
+      default:
+        key = std::rand () % 4;
+    }
+    items[i] = Item (key, i);
+  }
+  return items;
+}
+
+int main ()
+{
+  srand (0);
+  for (int size : {0, 1, 2, 3, 31, 32, 33, 64, 100, 1000, 4097, 100000})
+  {
+    for (int pattern = 0; pattern < PATTERNS; pattern++)
+    {
+      std::vector<Item> items = makeInput (size, pattern);
+      std::vector<Item> expected = items;
+      std::stable_sort (expected.begin (), expected.end (), keyLess);
+      naturalSort (items.begin (), items.end (), keyLess);
+      if (items != expected)
+      {
+        std::cout << "ERROR: PATTERN " << pattern << " OF " << size
+                  << " ITEMS ISN'T STABLY SORTED" << std::endl;
+        exit (EXIT_FAILURE);
+      }
+    }
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
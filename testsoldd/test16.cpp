@@ -0,0 +1,236 @@
+/**
+ * SortTask: a range cut into any number of leaves, run in any order or by
+ * several threads at once, comes out stably sorted and only the last leaf
+ * reports the root done. A job in which one record emits most of the pairs
+ * (a run the other map threads help sort) counts every key right.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include "../ParallelSort.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#define SIZE 100000
+#define SORTERS 4
+#define N 2000
+#define HEAVY_PAIRS 600000
+#define RANGE 5000
+#define THREADS 4
+
+using namespace std;
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+// ******************************************************************
+// *********************** SortTask *********************************
+// ******************************************************************
+
+// a key and its position in the input, only the key is compared
+typedef std::pair<int, int> Item;
+
+bool keyLess (const Item &item1, const Item &item2)
+{
+  return item1.first < item2.first;
+}
+
+typedef RangeSortTask<std::vector<Item>::iterator, bool (*) (const Item &, const Item &)> ItemSortTask;
+
+std::vector<Item> makeItems (int size)
+{
+  std::vector<Item> items (size);
+  for (int i = 0; i < size; i++)
+  {
+    // sorted stretches with random ones between them
+    int key = std::rand () % 3 == 0 ? std::rand () % 1000 : i / 100;
+    items[i] = Item (key, i);
+  }
+  return items;
+}
+
+typedef struct Sorter {
+    ItemSortTask *task;
+    pthread_mutex_t *mutex;
+    int roots;
+} Sorter;
+
+void *runLeaves (void *arg)
+{
+  Sorter *sorter = (Sorter *) arg;
+  while (true)
+  {
+    pthread_mutex_lock (sorter->mutex);
+    int leaf = sorter->task->next_leaf++;
+    pthread_mutex_unlock (sorter->mutex);
+    if (leaf >= sorter->task->leaves)
+    {
+      return nullptr;
+    }
+    sorter->roots += sorter->task->runLeaf (leaf, false);
+  }
+}
+
+void checkSortTask ()
+{
+  for (int leaves = 1; leaves <= 17; leaves++)
+  {
+    std::vector<Item> items = makeItems (SIZE);
+    std::vector<Item> expected = items;
+    std::stable_sort (expected.begin (), expected.end (), keyLess);
+
+    // the leaves in a random order
+    ItemSortTask task (items.begin (), items.size (), leaves, keyLess);
+    std::vector<int> order;
+    for (int leaf = 0; leaf < leaves; leaf++)
+    {
+      order.push_back (leaf);
+    }
+    std::random_shuffle (order.begin (), order.end ());
+    for (size_t i = 0; i < order.size (); i++)
+    {
+      bool root = task.runLeaf (order[i], false);
+      expect (root == (i + 1 == order.size ()), "THE ROOT WASN'T DONE LAST");
+    }
+    expect (items == expected, "LEAVES RUN IN ORDER DIDN'T SORT STABLY");
+
+    // several threads taking leaves
+    items = makeItems (SIZE);
+    expected = items;
+    std::stable_sort (expected.begin (), expected.end (), keyLess);
+    ItemSortTask shared (items.begin (), items.size (), leaves, keyLess);
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::vector<Sorter> sorters (SORTERS, Sorter{&shared, &mutex, 0});
+    std::vector<pthread_t> threads (SORTERS);
+    for (int i = 0; i < SORTERS; i++)
+    {
+      pthread_create (&threads[i], NULL, runLeaves, &sorters[i]);
+    }
+    int roots = 0;
+    for (int i = 0; i < SORTERS; i++)
+    {
+      pthread_join (threads[i], NULL);
+      roots += sorters[i].roots;
+    }
+    expect (roots == 1, "THE ROOT WASN'T DONE EXACTLY ONCE");
+    expect (items == expected, "LEAVES RUN BY THREADS DIDN'T SORT STABLY");
+  }
+}
+
+// ******************************************************************
+// *********************** skewed job *******************************
+// ******************************************************************
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {}
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+template<>
+struct arena_skips_destructor<Number> : std::true_type {};
+
+// record 0 emits HEAVY_PAIRS random keys, the others their own key
+struct MRSkewed : public MapReduceClient {
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      int n = ((const Number *) key)->n;
+      if (n >= 0)
+      {
+        emit2 (emitAlloc<Number> (context, n), emitAlloc<Number> (context, 1),
+               context);
+        return;
+      }
+      unsigned int seed = 1;
+      for (int i = 0; i < HEAVY_PAIRS; i++)
+      {
+        emit2 (emitAlloc<Number> (context, rand_r (&seed) % RANGE),
+               emitAlloc<Number> (context, 1), context);
+      }
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      emit3 (new Number (((const Number *) pairs->at (0).first)->n),
+             new Number ((int) pairs->size ()), context);
+    }
+};
+
+void checkSkewedJob ()
+{
+  InputVec numbers;
+  std::map<int, int> expectedOutput;
+  numbers.push_back (make_pair (new Number (-1), nullptr));
+  unsigned int seed = 1;
+  for (int i = 0; i < HEAVY_PAIRS; i++)
+  {
+    expectedOutput[rand_r (&seed) % RANGE]++;
+  }
+  for (int i = 1; i < N; ++i)
+  {
+    int n = std::rand () % RANGE;
+    numbers.push_back (make_pair (new Number (n), nullptr));
+    expectedOutput[n]++;
+  }
+
+  MRSkewed client;
+  OutputVec results;
+  JobOptions options;
+  options.sorted_output = true;
+  JobHandle job = startMapReduceJob (client, numbers, results, THREADS, options);
+  waitForJob (job);
+  closeJobHandle (job);
+
+  expect (results.size () == expectedOutput.size (), "WRONG NUMBER OF KEYS");
+  auto expected = expectedOutput.begin ();
+  for (OutputPair &pair : results)
+  {
+    expect (((Number *) pair.first)->n == expected->first
+            && ((Number *) pair.second)->n == expected->second,
+            "WRONG COUNT IN THE SKEWED JOB");
+    ++expected;
+    delete pair.first;
+    delete pair.second;
+  }
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+}
+
+int main ()
+{
+  srand (0);
+  checkSortTask ();
+  checkSkewedJob ();
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,254 @@
+/**
+ * JobOptions::split_threshold: a hot key with many times split_threshold
+ * pairs is cut into parts that several reducers count, and the client's
+ * merge adds the parts' counts up. Every key gets its full count, the
+ * output is in key order with sorted_output (and the same keys without
+ * it), merge ran, and every pair, partial and output object is freed.
+ * Runs with an object client and with a compact one.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+
+#define N 40000
+#define RANGE 500
+#define HOT_KEY 7
+#define SPLIT_THRESHOLD 1000
+#define THREADS 4
+
+using namespace std;
+
+std::atomic<int> live_numbers (0);
+std::atomic<int> merges (0);
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {
+      live_numbers++;
+    }
+
+    ~Number ()
+    {
+      live_numbers--;
+    }
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+// sums the counts of pairs (or partial outputs), all of the same key
+template<typename Pairs>
+int sumCounts (const Pairs *pairs)
+{
+  int count = 0;
+  for (const auto &pair : *pairs)
+  {
+    count += ((const Number *) pair.second)->n;
+  }
+  return count;
+}
+
+// adds up the counts the parts of a split group output, freeing them
+void mergeCounts (const OutputVec *partials, void *context)
+{
+  merges++;
+  int n = ((Number *) partials->at (0).first)->n;
+  int count = sumCounts (partials);
+  for (const OutputPair &pair : *partials)
+  {
+    delete pair.first;
+    delete pair.second;
+  }
+  emit3 (new Number (n), new Number (count), context);
+}
+
+struct MRCount : public MergeableMapReduceClient {
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      emit2 (new Number (((Number *) key)->n), new Number (1), context);
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      int n = ((Number *) pairs->at (0).first)->n;
+      int count = sumCounts (pairs);
+      for (const IntermediatePair &pair : *pairs)
+      {
+        delete pair.first;
+        delete pair.second;
+      }
+      emit3 (new Number (n), new Number (count), context);
+    }
+
+    virtual void merge (const OutputVec *partials, void *context) const override
+    {
+      mergeCounts (partials, context);
+    }
+};
+
+static void writeInt (int n, std::vector<char> *out)
+{
+  uint32_t bits = (uint32_t) n ^ 0x80000000u;
+  for (int shift = 24; shift >= 0; shift -= 8)
+  {
+    out->push_back ((char) (bits >> shift));
+  }
+}
+
+static int readInt (const char *data)
+{
+  uint32_t bits = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    bits = (bits << 8) | (uint8_t) data[i];
+  }
+  return (int) (bits ^ 0x80000000u);
+}
+
+// the same count on byte records; reduce gets pairs the framework frees
+struct MRCompactCount : public CompactMapReduceClient,
+                        public MergeableMapReduceClient {
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      Number k (((Number *) key)->n);
+      Number one (1);
+      emit2 (&k, &one, context);
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      int n = ((Number *) pairs->at (0).first)->n;
+      emit3 (new Number (n), new Number (sumCounts (pairs)), context);
+    }
+
+    virtual void merge (const OutputVec *partials, void *context) const override
+    {
+      mergeCounts (partials, context);
+    }
+
+    virtual void serializeKey (const K2 *key, std::vector<char> *out) const override
+    {
+      writeInt (((const Number *) key)->n, out);
+    }
+
+    virtual void serializeValue (const V2 *value, std::vector<char> *out) const override
+    {
+      writeInt (((const Number *) value)->n, out);
+    }
+
+    virtual K2 *deserializeKey (const char *data, size_t size, void *context) const override
+    {
+      (void) size;
+      return emitAlloc<Number> (context, readInt (data));
+    }
+
+    virtual V2 *deserializeValue (const char *data, size_t size, void *context) const override
+    {
+      (void) size;
+      return emitAlloc<Number> (context, readInt (data));
+    }
+};
+
+void runJob (const MapReduceClient &client, const InputVec &numbers,
+             const std::map<int, int> &expectedOutput, bool sorted_output)
+{
+  OutputVec results;
+  JobOptions options;
+  options.sorted_output = sorted_output;
+  options.split_threshold = SPLIT_THRESHOLD;
+  merges = 0;
+  JobHandle job = startMapReduceJob (client, numbers, results, THREADS, options);
+  waitForJob (job);
+  closeJobHandle (job);
+
+  expect (merges > 0, "THE HOT KEY WASN'T SPLIT AND MERGED");
+  expect (results.size () == expectedOutput.size (), "WRONG NUMBER OF KEYS");
+  if (sorted_output)
+  {
+    for (size_t i = 1; i < results.size (); i++)
+    {
+      expect (*results[i - 1].first < *results[i].first,
+              "SORTED OUTPUT ISN'T IN KEY ORDER");
+    }
+  }
+  else
+  {
+    std::sort (results.begin (), results.end (),
+               [] (const OutputPair &pair1, const OutputPair &pair2)
+               { return *pair1.first < *pair2.first; });
+  }
+  auto expected = expectedOutput.begin ();
+  for (OutputPair &pair : results)
+  {
+    expect (((Number *) pair.first)->n == expected->first
+            && ((Number *) pair.second)->n == expected->second,
+            "WRONG COUNT");
+    ++expected;
+    delete pair.first;
+    delete pair.second;
+  }
+  expect (live_numbers == (int) numbers.size (),
+          "INTERMEDIATE, PARTIAL OR OUTPUT OBJECTS WERE NOT FREED");
+}
+
+int main ()
+{
+  InputVec numbers;
+  std::map<int, int> expectedOutput;
+  srand (0);
+  for (int i = 0; i < N; ++i)
+  {
+    // half of the input is the hot key
+    int n = i % 2 == 0 ? HOT_KEY : std::rand () % RANGE;
+    numbers.push_back (make_pair (new Number (n), nullptr));
+    expectedOutput[n]++;
+  }
+
+  MRCount count;
+  MRCompactCount compact;
+  for (bool sorted_output : {true, false})
+  {
+    runJob (count, numbers, expectedOutput, sorted_output);
+    // the compact client is passed as its CompactMapReduceClient base
+    runJob ((const CompactMapReduceClient &) compact, numbers, expectedOutput,
+            sorted_output);
+  }
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,186 @@
+/**
+ * JobLog: records logged from several threads at once all reach the file,
+ * each thread's in the order it logged them, after the header line. While
+ * threads keep logging the log is closed and reopened over and over: every
+ * line written is whole and each thread's records stay in order.
+ */
+#include "../JobLog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define THREADS 8
+// THREADS * RECORDS stays below the queue's 4096 cells, so none is dropped
+#define RECORDS 400
+#define TOGGLES 50
+
+using namespace std;
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+std::string tempPath ()
+{
+  char path[] = "/tmp/joblogXXXXXX";
+  int fd = mkstemp (path);
+  expect (fd >= 0, "CAN'T CREATE A TEMPORARY FILE");
+  close (fd);
+  return path;
+}
+
+std::vector<std::string> readLines (const std::string &path)
+{
+  std::ifstream file (path);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline (file, line))
+  {
+    lines.push_back (line);
+  }
+  return lines;
+}
+
+// the thread and the count of a "thread t terminated after i items" line
+bool parseRecord (const std::string &line, int *thread, long long *item)
+{
+  return sscanf (line.c_str (), "[%*u.%*u] thread %d terminated after %lld items",
+                 thread, item) == 2;
+}
+
+typedef struct Logger {
+    int thread_id;
+    std::atomic<bool> *stop;
+} Logger;
+
+void *logRecords (void *arg)
+{
+  Logger *logger = (Logger *) arg;
+  for (long long i = 0; i < RECORDS; i++)
+  {
+    jobLog (LOG_THREAD_TERMINATED, logger->thread_id, 0, i);
+  }
+  return nullptr;
+}
+
+void *logUntilStopped (void *arg)
+{
+  Logger *logger = (Logger *) arg;
+  for (long long i = 0; not logger->stop->load (); i++)
+  {
+    jobLog (LOG_THREAD_TERMINATED, logger->thread_id, 0, i);
+    if (i % 64 == 0)
+    {
+      usleep (10);
+    }
+  }
+  return nullptr;
+}
+
+void runThreads (void *(*function) (void *), std::atomic<bool> *stop,
+                 void (*meanwhile) ())
+{
+  std::vector<Logger> loggers (THREADS);
+  std::vector<pthread_t> threads (THREADS);
+  for (int i = 0; i < THREADS; i++)
+  {
+    loggers[i] = Logger{i, stop};
+    pthread_create (&threads[i], NULL, function, &loggers[i]);
+  }
+  meanwhile ();
+  for (int i = 0; i < THREADS; i++)
+  {
+    pthread_join (threads[i], NULL);
+  }
+}
+
+void checkEveryRecord ()
+{
+  std::string path = tempPath ();
+  expect (jobLogOpen (path.c_str ()), "CAN'T OPEN THE LOG");
+  runThreads (logRecords, nullptr, [] () {});
+  jobLogClose ();
+
+  std::vector<std::string> lines = readLines (path);
+  unlink (path.c_str ());
+  expect (not lines.empty ()
+          && lines[0].find ("MapReduceFramework log opened") == 0,
+          "THE LOG DOESN'T START WITH ITS HEADER");
+  expect (lines.size () == 1 + THREADS * RECORDS, "RECORDS WERE LOST");
+  std::vector<long long> next (THREADS, 0);
+  for (size_t i = 1; i < lines.size (); i++)
+  {
+    int thread;
+    long long item;
+    expect (parseRecord (lines[i], &thread, &item), "A LINE ISN'T A RECORD");
+    expect (thread >= 0 && thread < THREADS && item == next[thread]++,
+            "A THREAD'S RECORDS ARE OUT OF ORDER");
+  }
+}
+
+std::atomic<bool> stop_logging (false);
+std::string toggled_path;
+
+void toggleLog ()
+{
+  for (int i = 0; i < TOGGLES; i++)
+  {
+    expect (jobLogOpen (toggled_path.c_str ()), "CAN'T REOPEN THE LOG");
+    usleep (1000);
+    jobLogClose ();
+  }
+  stop_logging = true;
+}
+
+void checkToggling ()
+{
+  toggled_path = tempPath ();
+  runThreads (logUntilStopped, &stop_logging, toggleLog);
+
+  std::vector<std::string> lines = readLines (toggled_path);
+  unlink (toggled_path.c_str ());
+  std::vector<long long> last (THREADS, -1);
+  int headers = 0;
+  for (const std::string &line : lines)
+  {
+    if (line.find ("MapReduceFramework log opened") == 0)
+    {
+      headers++;
+      continue;
+    }
+    // the queue may fill up while the threads log nonstop
+    unsigned long long dropped;
+    if (sscanf (line.c_str (), "[log] %llu records dropped", &dropped) == 1)
+    {
+      continue;
+    }
+    int thread;
+    long long item;
+    expect (parseRecord (line, &thread, &item), "A LINE ISN'T A WHOLE RECORD");
+    expect (thread >= 0 && thread < THREADS && item > last[thread],
+            "A THREAD'S RECORDS ARE OUT OF ORDER");
+    last[thread] = item;
+  }
+  expect (headers == TOGGLES, "A REOPENED LOG DIDN'T WRITE ITS HEADER");
+}
+
+int main ()
+{
+  checkEveryRecord ();
+  checkToggling ();
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,164 @@
+/**
+ * JobOptions::compress_runs: a compact client's map threads each emit
+ * several times RUN_SPILL_RECORDS records, so every thread compresses a few
+ * runs and the shuffle merges them back. Every key gets the sum of its
+ * values, in key order, as without compress_runs. Runs with a fixed and
+ * with an auto thread count.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+
+// about 150000 records per thread, over twice the 64K a run is spilled at
+#define N 600000
+#define RANGE 5000
+#define THREADS 4
+
+using namespace std;
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {}
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+template<>
+struct arena_skips_destructor<Number> : std::true_type {};
+
+static void writeInt (int n, std::vector<char> *out)
+{
+  uint32_t bits = (uint32_t) n ^ 0x80000000u;
+  for (int shift = 24; shift >= 0; shift -= 8)
+  {
+    out->push_back ((char) (bits >> shift));
+  }
+}
+
+static int readInt (const char *data)
+{
+  uint32_t bits = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    bits = (bits << 8) | (uint8_t) data[i];
+  }
+  return (int) (bits ^ 0x80000000u);
+}
+
+struct MRNumber : public CompactMapReduceClient {
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      Number k (((Number *) key)->n);
+      Number v (((Number *) value)->n);
+      emit2 (&k, &v, context);
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      int n = ((Number *) pairs->at (0).first)->n;
+      int sum = 0;
+      for (const IntermediatePair &pair : *pairs)
+      {
+        sum += ((Number *) pair.second)->n;
+      }
+      emit3 (new Number (n), new Number (sum), context);
+    }
+
+    virtual void serializeKey (const K2 *key, std::vector<char> *out) const override
+    {
+      writeInt (((const Number *) key)->n, out);
+    }
+
+    virtual void serializeValue (const V2 *value, std::vector<char> *out) const override
+    {
+      writeInt (((const Number *) value)->n, out);
+    }
+
+    virtual K2 *deserializeKey (const char *data, size_t size, void *context) const override
+    {
+      (void) size;
+      return emitAlloc<Number> (context, readInt (data));
+    }
+
+    virtual V2 *deserializeValue (const char *data, size_t size, void *context) const override
+    {
+      (void) size;
+      return emitAlloc<Number> (context, readInt (data));
+    }
+};
+
+int main ()
+{
+  InputVec numbers;
+  std::map<int, int> expectedOutput;
+  srand (0);
+  for (int i = 0; i < N; ++i)
+  {
+    int n = std::rand () % RANGE - RANGE / 2;
+    int value = std::rand () % 100;
+    numbers.push_back (make_pair (new Number (n), new Number (value)));
+    expectedOutput[n] += value;
+  }
+
+  MRNumber m;
+  for (int threads : {THREADS, 0})
+  {
+    OutputVec results;
+    JobOptions options;
+    options.sorted_output = true;
+    options.compress_runs = true;
+    auto job = startMapReduceJob (m, numbers, results, threads, options);
+    waitForJob (job);
+    closeJobHandle (job);
+
+    if (results.size () != expectedOutput.size ())
+    {
+      std::cout << "ERROR: EXPECTED " << expectedOutput.size () << " KEYS, GOT "
+                << results.size () << std::endl;
+      exit (EXIT_FAILURE);
+    }
+    auto expected = expectedOutput.begin ();
+    for (OutputPair &pair : results)
+    {
+      int n = ((Number *) pair.first)->n;
+      int sum = ((Number *) pair.second)->n;
+      if (n != expected->first || sum != expected->second)
+      {
+        std::cout << "ERROR OF KEY:" << n << std::endl << "ACTUAL VALUE: " << sum
+                  << ", EXPECTED KEY " << expected->first << " WITH VALUE "
+                  << expected->second << std::endl;
+        exit (EXIT_FAILURE);
+      }
+      ++expected;
+      delete pair.first;
+      delete pair.second;
+    }
+  }
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+    delete pair.second;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,225 @@
+/**
+ * ObjectPool: a freed object is the next one its size class hands out and
+ * never one of another class, PoolObject outputs allocated on one thread
+ * are deleted on another through their K3/V3 base, and the objects a
+ * thread freed are reused by a later thread once it exits. No object is
+ * leaked or handed out twice at once.
+ */
+#include "../MapReduceClient.h"
+#include "../ObjectPool.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <atomic>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#define OBJECTS 10000
+#define FLUSHED 100
+// a size class no other part of the test allocates from
+#define FLUSHED_SIZE 200
+#define REFILLS 2000
+
+using namespace std;
+
+std::atomic<int> live_objects (0);
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+struct Number : public K3, public PoolObject {
+    int n;
+
+    Number (int n) : n (n)
+    {
+      live_objects++;
+    }
+
+    ~Number ()
+    {
+      live_objects--;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+// a V3 of another size class
+struct Payload : public V3, public PoolObject {
+    char bytes[100];
+
+    Payload ()
+    {
+      live_objects++;
+    }
+
+    ~Payload ()
+    {
+      live_objects--;
+    }
+};
+
+// over POOL_MAX_OBJECT, served by malloc
+struct Large : public V3, public PoolObject {
+    char bytes[POOL_MAX_OBJECT + 1];
+
+    Large ()
+    {
+      live_objects++;
+    }
+
+    ~Large ()
+    {
+      live_objects--;
+    }
+};
+
+void checkReuse ()
+{
+  for (size_t size = 1; size <= POOL_MAX_OBJECT; size++)
+  {
+    void *object = poolAllocate (size);
+    poolFree (object, size);
+    expect (poolAllocate (size) == object, "A FREED OBJECT WASN'T REUSED");
+    // a size class holds objects of at least the largest of its sizes
+    void *other = poolAllocate (size);
+    expect (other != object, "AN OBJECT WAS HANDED OUT TWICE");
+    poolFree (other, size);
+    poolFree (object, size);
+  }
+
+  Number *number = new Number (1);
+  K3 *key = number;
+  delete key;
+  Payload *payload = new Payload ();
+  expect ((void *) payload != (void *) number,
+          "SIZE CLASSES SHARE OBJECTS");
+  V3 *value = payload;
+  delete value;
+  expect (new Number (2) == number, "A DELETED K3 WASN'T REUSED");
+  delete number;
+  expect (live_objects == 0, "AN OBJECT WASN'T DESTROYED");
+}
+
+// ******************************************************************
+// *********************** cross-thread free ************************
+// ******************************************************************
+
+typedef struct Outputs {
+    std::vector<K3 *> keys;
+    std::vector<V3 *> values;
+} Outputs;
+
+void *allocateOutputs (void *arg)
+{
+  Outputs *outputs = (Outputs *) arg;
+  for (int i = 0; i < OBJECTS; i++)
+  {
+    outputs->keys.push_back (new Number (i));
+    outputs->values.push_back (i % 2 == 0 ? (V3 *) new Payload ()
+                                          : (V3 *) new Large ());
+  }
+  return nullptr;
+}
+
+void *deleteOutputs (void *arg)
+{
+  Outputs *outputs = (Outputs *) arg;
+  for (int i = 0; i < OBJECTS; i++)
+  {
+    delete outputs->keys[i];
+    delete outputs->values[i];
+  }
+  return nullptr;
+}
+
+void runThread (void *(*function) (void *), void *arg)
+{
+  pthread_t thread;
+  pthread_create (&thread, NULL, function, arg);
+  pthread_join (thread, NULL);
+}
+
+void checkCrossThreadFree ()
+{
+  for (int round = 0; round < 3; round++)
+  {
+    Outputs outputs;
+    runThread (allocateOutputs, &outputs);
+    std::set<void *> distinct (outputs.keys.begin (), outputs.keys.end ());
+    distinct.insert (outputs.values.begin (), outputs.values.end ());
+    expect (distinct.size () == 2 * OBJECTS, "AN OBJECT WAS HANDED OUT TWICE");
+    expect (live_objects == 2 * OBJECTS, "AN OUTPUT WASN'T CONSTRUCTED");
+    runThread (deleteOutputs, &outputs);
+    expect (live_objects == 0, "AN OUTPUT WASN'T DESTROYED");
+  }
+}
+
+// ******************************************************************
+// *********************** thread exit ******************************
+// ******************************************************************
+
+void *allocateAndFree (void *arg)
+{
+  std::set<void *> *addresses = (std::set<void *> *) arg;
+  std::vector<void *> objects;
+  for (int i = 0; i < FLUSHED; i++)
+  {
+    objects.push_back (poolAllocate (FLUSHED_SIZE));
+    addresses->insert (objects.back ());
+  }
+  // the last ones freed stay in this thread's cache until it exits
+  for (void *object : objects)
+  {
+    poolFree (object, FLUSHED_SIZE);
+  }
+  return nullptr;
+}
+
+void *allocateAll (void *arg)
+{
+  std::set<void *> *addresses = (std::set<void *> *) arg;
+  std::vector<void *> objects;
+  for (int i = 0; i < REFILLS; i++)
+  {
+    objects.push_back (poolAllocate (FLUSHED_SIZE));
+    addresses->insert (objects.back ());
+  }
+  for (void *object : objects)
+  {
+    poolFree (object, FLUSHED_SIZE);
+  }
+  return nullptr;
+}
+
+void checkThreadExit ()
+{
+  std::set<void *> freed;
+  runThread (allocateAndFree, &freed);
+  std::set<void *> reused;
+  runThread (allocateAll, &reused);
+  expect (reused.size () == REFILLS, "AN OBJECT WAS HANDED OUT TWICE");
+  for (void *object : freed)
+  {
+    expect (reused.count (object) == 1,
+            "AN EXITED THREAD'S CACHE WASN'T GIVEN BACK TO THE POOL");
+  }
+}
+
+int main ()
+{
+  checkReuse ();
+  checkCrossThreadFree ();
+  checkThreadExit ();
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * KeyDictionary: ids are dense and in order of first appearance, interning
+ * a key again gives its id back, and keys that differ only in length or in
+ * an embedded '\0' get ids of their own. Threads interning the same keys in
+ * different orders all get the same id for every key, and lookup gives back
+ * the key of every id a thread got while the others are still interning.
+ */
+#include "../KeyDictionary.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#define KEYS 20000
+#define THREADS 8
+
+using namespace std;
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+uint32_t intern (KeyDictionary &dictionary, const std::string &key)
+{
+  return dictionary.intern (key.data (), key.size ());
+}
+
+void checkDenseIds ()
+{
+  KeyDictionary dictionary;
+  std::vector<std::string> keys = {"a", "b", "", "ab", std::string ("ab\0", 3),
+                                   "ba", std::string ("a\0b", 3)};
+  for (size_t i = 0; i < keys.size (); i++)
+  {
+    expect (intern (dictionary, keys[i]) == i, "IDS AREN'T DENSE");
+  }
+  for (size_t i = 0; i < keys.size (); i++)
+  {
+    expect (intern (dictionary, keys[i]) == i, "A KEY'S ID CHANGED");
+    expect (dictionary.lookup ((uint32_t) i) == keys[i], "LOOKUP GAVE ANOTHER KEY");
+  }
+  expect (dictionary.size () == keys.size (), "WRONG SIZE");
+}
+
+// ******************************************************************
+// *********************** concurrent interning *********************
+// ******************************************************************
+
+std::vector<std::string> keys;
+
+typedef struct Interner {
+    KeyDictionary *dictionary;
+    int seed;
+    // the id the thread got for every key
+    std::vector<uint32_t> ids;
+    bool lookups_ok;
+} Interner;
+
+void *internKeys (void *arg)
+{
+  Interner *interner = (Interner *) arg;
+  std::vector<int> order (KEYS);
+  for (int i = 0; i < KEYS; i++)
+  {
+    order[i] = i;
+  }
+  std::minstd_rand random (interner->seed);
+  std::shuffle (order.begin (), order.end (), random);
+
+  interner->ids.assign (KEYS, 0);
+  interner->lookups_ok = true;
+  for (int i : order)
+  {
+    uint32_t id = intern (*interner->dictionary, keys[i]);
+    interner->ids[i] = id;
+    if (interner->dictionary->lookup (id) != keys[i])
+    {
+      interner->lookups_ok = false;
+    }
+  }
+  return nullptr;
+}
+
+void checkConcurrentInterning ()
+{
+  for (int i = 0; i < KEYS; i++)
+  {
+    // keys of many lengths, some sharing long prefixes
+    keys.push_back ("key" + std::to_string (i) + std::string (i % 40, 'x'));
+  }
+
+  KeyDictionary dictionary;
+  std::vector<Interner> interners (THREADS);
+  std::vector<pthread_t> threads (THREADS);
+  for (int i = 0; i < THREADS; i++)
+  {
+    interners[i].dictionary = &dictionary;
+    interners[i].seed = i + 1;
+    pthread_create (&threads[i], NULL, internKeys, &interners[i]);
+  }
+  for (int i = 0; i < THREADS; i++)
+  {
+    pthread_join (threads[i], NULL);
+    expect (interners[i].lookups_ok, "LOOKUP GAVE ANOTHER KEY WHILE INTERNING");
+    expect (interners[i].ids == interners[0].ids, "THREADS GOT DIFFERENT IDS");
+  }
+
+  expect (dictionary.size () == KEYS, "WRONG SIZE");
+  std::vector<bool> seen (KEYS, false);
+  for (int i = 0; i < KEYS; i++)
+  {
+    uint32_t id = interners[0].ids[i];
+    expect (id < KEYS && not seen[id], "IDS AREN'T DENSE");
+    seen[id] = true;
+    expect (dictionary.lookup (id) == keys[i], "LOOKUP GAVE ANOTHER KEY");
+    expect (intern (dictionary, keys[i]) == id, "A KEY'S ID CHANGED");
+  }
+}
+
+int main ()
+{
+  checkDenseIds ();
+  checkConcurrentInterning ();
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
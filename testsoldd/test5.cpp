@@ -0,0 +1,146 @@
+/**
+ * emitAlloc: intermediate keys and values live in the job's arenas and are
+ * released by closeJobHandle, the reducer never deletes them.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdlib.h>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <string>
+
+#define N 20000
+#define RANGE 300
+#define THREADS 8
+
+using namespace std;
+
+std::atomic<int> live_labels (0);
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {}
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+// Number only has a virtual destructor, so the arena may skip it
+template<>
+struct arena_skips_destructor<Number> : std::true_type {};
+
+// a value with a real destructor, closeJobHandle has to run it
+struct Label : public V2 {
+    std::string text;
+
+    Label (const std::string &text) : text (text)
+    {
+      live_labels++;
+    }
+
+    ~Label ()
+    {
+      live_labels--;
+    }
+};
+
+struct MRNumber : public MapReduceClient {
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      int n = ((Number *) key)->n;
+      emit2 (emitAlloc<Number> (context, n), emitAlloc<Number> (context, 1), context);
+      if (n % 10 == 0)
+      {
+        emit2 (emitAlloc<Number> (context, n),
+               emitAlloc<Label> (context, "a label long enough to need the heap"),
+               context);
+      }
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      int n = ((Number *) pairs->at (0).first)->n;
+      int count = 0;
+      for (const IntermediatePair &pair : *pairs)
+      {
+        if (dynamic_cast<Label *> (pair.second) == nullptr)
+        {
+          count++;
+        }
+      }
+      emit3 (new Number (n), new Number (count), context);
+    }
+};
+
+int main ()
+{
+  InputVec numbers;
+  std::map<int, int> expectedOutput;
+  srand (0);
+  for (int i = 0; i < N; ++i)
+  {
+    int n = std::rand () % RANGE;
+    numbers.push_back (make_pair (new Number (n), nullptr));
+    expectedOutput[n]++;
+  }
+
+  MRNumber m;
+  OutputVec results;
+  JobOptions options;
+  options.sorted_output = true;
+  auto job = startMapReduceJob (m, numbers, results, THREADS, options);
+  waitForJob (job);
+  closeJobHandle (job);
+
+  if (live_labels != 0)
+  {
+    std::cout << "ERROR: " << live_labels << " LABELS WERE NOT DESTROYED" << std::endl;
+    exit (EXIT_FAILURE);
+  }
+  if (results.size () != expectedOutput.size ())
+  {
+    std::cout << "ERROR: EXPECTED " << expectedOutput.size () << " KEYS, GOT "
+              << results.size () << std::endl;
+    exit (EXIT_FAILURE);
+  }
+  auto expected = expectedOutput.begin ();
+  for (OutputPair &pair : results)
+  {
+    int c = ((Number *) pair.first)->n;
+    int count = ((Number *) pair.second)->n;
+    if (c != expected->first || count != expected->second)
+    {
+      std::cout << "ERROR OF KEY:" << c << std::endl << "ACTUAL VALUE: " << count
+                << ", EXPECTED KEY " << expected->first << " WITH VALUE "
+                << expected->second << std::endl;
+      exit (EXIT_FAILURE);
+    }
+    ++expected;
+    delete pair.first;
+    delete pair.second;
+  }
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
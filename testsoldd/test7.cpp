@@ -0,0 +1,202 @@
+/**
+ * cancelJob and JobOptions::deadline_ms: a cancelled job stops early, reports
+ * CANCELLED_STAGE, and every pair that wasn't reduced reaches discard. A
+ * cancellation that arrives while the last group is being reduced has
+ * nothing left to stop and the job finishes.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <atomic>
+#include <iostream>
+
+#define N 4000
+#define RANGE 1000
+#define THREADS 4
+
+using namespace std;
+
+std::atomic<int> live_numbers (0);
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {
+      live_numbers++;
+    }
+
+    ~Number ()
+    {
+      live_numbers--;
+    }
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+struct MRNumber : public MapReduceClient {
+    useconds_t map_sleep;
+    useconds_t reduce_sleep;
+
+    MRNumber (useconds_t map_sleep, useconds_t reduce_sleep)
+        : map_sleep (map_sleep), reduce_sleep (reduce_sleep)
+    {}
+
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      usleep (map_sleep);
+      emit2 (new Number (((Number *) key)->n), new Number (1), context);
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      usleep (reduce_sleep);
+      int n = ((Number *) pairs->at (0).first)->n;
+      for (const IntermediatePair &pair : *pairs)
+      {
+        delete pair.first;
+        delete pair.second;
+      }
+      emit3 (new Number (n), new Number ((int) pairs->size ()), context);
+    }
+
+    virtual void discard (const IntermediateVec *pairs) const override
+    {
+      for (const IntermediatePair &pair : *pairs)
+      {
+        delete pair.first;
+        delete pair.second;
+      }
+    }
+};
+
+long long nowMillis ()
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+// runs a job, cancelling it after cancel_after_ms unless that is negative,
+// and returns its final stage after checking every object was freed
+stage_t runJob (const InputVec &numbers, const MRNumber &client,
+                const JobOptions &options, int cancel_after_ms,
+                size_t *outputs, long long *millis)
+{
+  OutputVec results;
+  long long begin = nowMillis ();
+  JobHandle job = startMapReduceJob (client, numbers, results, THREADS, options);
+  if (cancel_after_ms >= 0)
+  {
+    usleep (cancel_after_ms * 1000);
+    cancelJob (job);
+  }
+  waitForJob (job);
+  *millis = nowMillis () - begin;
+  JobState state;
+  getJobState (job, &state);
+  closeJobHandle (job);
+
+  *outputs = results.size ();
+  for (OutputPair &pair : results)
+  {
+    delete pair.first;
+    delete pair.second;
+  }
+  if (live_numbers != (int) numbers.size ())
+  {
+    std::cout << "ERROR: " << live_numbers - (int) numbers.size ()
+              << " INTERMEDIATE OR OUTPUT OBJECTS WERE NOT FREED" << std::endl;
+    exit (EXIT_FAILURE);
+  }
+  return state.stage;
+}
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+int main ()
+{
+  InputVec numbers;
+  for (int i = 0; i < N; ++i)
+  {
+    numbers.push_back (make_pair (new Number (i % RANGE), nullptr));
+  }
+
+  size_t outputs;
+  long long millis;
+  JobOptions options;
+
+  // N * 500us over 4 threads takes half a second to map
+  MRNumber slow_map (500, 0);
+  stage_t stage = runJob (numbers, slow_map, options, 50, &outputs, &millis);
+  expect (stage == CANCELLED_STAGE, "CANCELLED MAP DIDN'T REPORT CANCELLED_STAGE");
+  expect (outputs == 0, "CANCELLED MAP PRODUCED OUTPUT");
+  expect (millis < 300, "CANCELLED MAP DIDN'T STOP EARLY");
+
+  // a deadline cancels the job by itself
+  JobOptions deadline;
+  deadline.deadline_ms = 50;
+  stage = runJob (numbers, slow_map, deadline, -1, &outputs, &millis);
+  expect (stage == CANCELLED_STAGE, "DEADLINE DIDN'T CANCEL THE JOB");
+  expect (millis < 300, "DEADLINE DIDN'T STOP THE JOB EARLY");
+
+  // RANGE groups * 1ms over 4 threads takes a quarter second to reduce,
+  // sorted output has to place the groups reduced before the cancellation
+  MRNumber slow_reduce (0, 1000);
+  options.sorted_output = true;
+  stage = runJob (numbers, slow_reduce, options, 100, &outputs, &millis);
+  expect (stage == CANCELLED_STAGE, "CANCELLED REDUCE DIDN'T REPORT CANCELLED_STAGE");
+  expect (outputs < RANGE, "CANCELLED REDUCE REDUCED EVERY GROUP");
+
+  // a job that finished before the cancellation keeps its output
+  MRNumber fast (0, 0);
+  stage = runJob (numbers, fast, options, 300, &outputs, &millis);
+  expect (stage != CANCELLED_STAGE, "A FINISHED JOB WAS CANCELLED");
+  expect (outputs == RANGE, "A FINISHED JOB LOST OUTPUT");
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+
+  // one group whose reduce takes 300ms, cancelled while it is reduced
+  InputVec one_group;
+  for (int i = 0; i < THREADS; ++i)
+  {
+    one_group.push_back (make_pair (new Number (0), nullptr));
+  }
+  MRNumber slow_last (0, 300000);
+  stage = runJob (one_group, slow_last, options, 100, &outputs, &millis);
+  expect (stage == REDUCE_STAGE, "A CANCELLATION AFTER THE LAST GROUP CANCELLED THE JOB");
+  expect (outputs == 1, "A CANCELLATION AFTER THE LAST GROUP LOST ITS OUTPUT");
+  for (InputPair &pair : one_group)
+  {
+    delete pair.first;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
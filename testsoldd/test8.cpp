@@ -0,0 +1,172 @@
+/**
+ * job completion: waitForJobTimeout times out on a running job and returns
+ * once it completes, the callback runs once and the eventfd becomes
+ * readable, also when they are registered after the job completed. While
+ * the job runs its percentage never goes back within a stage, and it ends
+ * in REDUCE_STAGE at 100%.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <atomic>
+#include <iostream>
+
+#define N 400
+#define THREADS 4
+
+using namespace std;
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {}
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+template<>
+struct arena_skips_destructor<Number> : std::true_type {};
+
+struct MRNumber : public MapReduceClient {
+    useconds_t map_sleep;
+
+    MRNumber (useconds_t map_sleep) : map_sleep (map_sleep)
+    {}
+
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      usleep (map_sleep);
+      int n = ((Number *) key)->n;
+      emit2 (emitAlloc<Number> (context, n), emitAlloc<Number> (context, 1), context);
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      int n = ((Number *) pairs->at (0).first)->n;
+      emit3 (new Number (n), new Number ((int) pairs->size ()), context);
+    }
+};
+
+typedef struct Completion {
+    std::atomic<int> calls;
+    stage_t stage;
+} Completion;
+
+void onComplete (JobHandle job, void *arg)
+{
+  Completion *completion = (Completion *) arg;
+  JobState state;
+  getJobState (job, &state);
+  completion->stage = state.stage;
+  completion->calls++;
+}
+
+void expect (bool condition, const char *message)
+{
+  if (not condition)
+  {
+    std::cout << "ERROR: " << message << std::endl;
+    exit (EXIT_FAILURE);
+  }
+}
+
+bool readable (int fd, int timeout_ms)
+{
+  struct pollfd poll_fd = {fd, POLLIN, 0};
+  return poll (&poll_fd, 1, timeout_ms) == 1 && (poll_fd.revents & POLLIN);
+}
+
+void freeOutput (OutputVec &results)
+{
+  for (OutputPair &pair : results)
+  {
+    delete pair.first;
+    delete pair.second;
+  }
+}
+
+int main ()
+{
+  InputVec numbers;
+  for (int i = 0; i < N; ++i)
+  {
+    numbers.push_back (make_pair (new Number (i % 10), nullptr));
+  }
+
+  // N * 1ms over 4 threads keeps the job running for about 100ms
+  MRNumber slow (1000);
+  OutputVec results;
+  Completion completion;
+  completion.calls = 0;
+  JobHandle job = startMapReduceJob (slow, numbers, results, THREADS);
+  setJobCallback (job, onComplete, &completion);
+  int fd = getJobEventFd (job);
+  expect (fd >= 0, "NO EVENTFD");
+  expect (not waitForJobTimeout (job, 10), "WAIT DIDN'T TIME OUT ON A RUNNING JOB");
+  expect (not readable (fd, 0), "EVENTFD READABLE BEFORE THE JOB COMPLETED");
+  JobState last = {UNDEFINED_STAGE, 0};
+  bool saw_progress = false;
+  while (not readable (fd, 1))
+  {
+    JobState state;
+    getJobState (job, &state);
+    expect (state.stage >= last.stage, "STAGE WENT BACK");
+    expect (state.percentage >= 0 && state.percentage <= 100,
+            "PERCENTAGE OUT OF RANGE");
+    expect (state.stage != last.stage || state.percentage >= last.percentage,
+            "PERCENTAGE WENT BACK");
+    saw_progress |= state.stage == MAP_STAGE && state.percentage > 0
+                    && state.percentage < 100;
+    last = state;
+  }
+  expect (saw_progress, "MAP_STAGE NEVER REPORTED PARTIAL PROGRESS");
+  expect (waitForJobTimeout (job, 5000), "WAIT TIMED OUT ON A COMPLETING JOB");
+  waitForJob (job);
+  expect (completion.calls == 1, "CALLBACK DIDN'T RUN EXACTLY ONCE");
+  expect (completion.stage == REDUCE_STAGE, "CALLBACK RAN BEFORE THE FINAL STAGE");
+  getJobState (job, &last);
+  expect (last.stage == REDUCE_STAGE && last.percentage == 100,
+          "A FINISHED JOB ISN'T IN REDUCE_STAGE AT 100%");
+  expect (results.size () == 10, "WRONG OUTPUT");
+  closeJobHandle (job);
+  freeOutput (results);
+  results.clear ();
+
+  // registered after completion: the callback runs right away and the
+  // eventfd starts out readable
+  MRNumber fast (0);
+  completion.calls = 0;
+  job = startMapReduceJob (fast, numbers, results, THREADS);
+  waitForJob (job);
+  setJobCallback (job, onComplete, &completion);
+  expect (completion.calls == 1, "LATE CALLBACK DIDN'T RUN");
+  expect (readable (getJobEventFd (job), 0), "LATE EVENTFD NOT READABLE");
+  expect (waitForJobTimeout (job, 0), "WAIT ON A COMPLETED JOB TIMED OUT");
+  closeJobHandle (job);
+  freeOutput (results);
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}
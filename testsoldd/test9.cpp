@@ -0,0 +1,168 @@
+/**
+ * startMapReduceChain: a count of every number feeds a histogram of the
+ * counts (how many numbers appeared k times) without an OutputVec or
+ * InputVec in between, and every pair passed along the chain is freed.
+ */
+#include "../MapReduceClient.h"
+#include "../MapReduceFramework.h"
+#include <stdlib.h>
+#include <atomic>
+#include <iostream>
+#include <map>
+
+#define N 100000
+#define RANGE 5000
+#define THREADS 6
+
+using namespace std;
+
+std::atomic<int> live_numbers (0);
+
+struct Number : public K1, public K2, public K3, public V1, public V2, public V3 {
+    int n;
+
+    Number (int n) : n (n)
+    {
+      live_numbers++;
+    }
+
+    ~Number ()
+    {
+      live_numbers--;
+    }
+
+    bool operator< (const K1 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K2 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+
+    bool operator< (const K3 &other) const
+    {
+      return n < ((Number &) other).n;
+    }
+};
+
+// (n) -> (n, count of n)
+struct MRCount : public MapReduceClient {
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) value;
+      emit2 (new Number (((Number *) key)->n), new Number (1), context);
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      int n = ((Number *) pairs->at (0).first)->n;
+      for (const IntermediatePair &pair : *pairs)
+      {
+        delete pair.first;
+        delete pair.second;
+      }
+      emit3 (new Number (n), new Number ((int) pairs->size ()), context);
+    }
+};
+
+// (n, count) -> (count, how many numbers have it)
+struct MRHistogram : public ChainedMapReduceClient {
+    virtual void map (const K1 *key, const V1 *value, void *context) const override
+    {
+      (void) key;
+      (void) value;
+      (void) context;
+      std::cout << "ERROR: THE CHAINED CLIENT MAPPED INPUT" << std::endl;
+      exit (EXIT_FAILURE);
+    }
+
+    virtual void mapOutput (const K3 *key, const V3 *value, void *context) const override
+    {
+      int count = ((const Number *) value)->n;
+      delete key;
+      delete value;
+      emit2 (new Number (count), new Number (1), context);
+    }
+
+    virtual void reduce (const IntermediateVec *pairs, void *context) const override
+    {
+      int count = ((Number *) pairs->at (0).first)->n;
+      for (const IntermediatePair &pair : *pairs)
+      {
+        delete pair.first;
+        delete pair.second;
+      }
+      emit3 (new Number (count), new Number ((int) pairs->size ()), context);
+    }
+};
+
+int main ()
+{
+  InputVec numbers;
+  std::map<int, int> counts;
+  srand (0);
+  for (int i = 0; i < N; ++i)
+  {
+    int n = std::rand () % RANGE;
+    numbers.push_back (make_pair (new Number (n), nullptr));
+    counts[n]++;
+  }
+  std::map<int, int> expectedOutput;
+  for (auto &count : counts)
+  {
+    expectedOutput[count.second]++;
+  }
+
+  MRCount count;
+  MRHistogram histogram;
+  // in auto mode too, the warm-up only maps with the first client
+  for (int threads : {THREADS, 0})
+  {
+    OutputVec results;
+    JobOptions options;
+    options.sorted_output = true;
+    JobHandle job = startMapReduceChain ({&count, &histogram}, numbers, results,
+                                         threads, options);
+    waitForJob (job);
+    closeJobHandle (job);
+
+    if (results.size () != expectedOutput.size ())
+    {
+      std::cout << "ERROR: EXPECTED " << expectedOutput.size () << " KEYS, GOT "
+                << results.size () << std::endl;
+      exit (EXIT_FAILURE);
+    }
+    auto expected = expectedOutput.begin ();
+    for (OutputPair &pair : results)
+    {
+      int c = ((Number *) pair.first)->n;
+      int numbers_with_c = ((Number *) pair.second)->n;
+      if (c != expected->first || numbers_with_c != expected->second)
+      {
+        std::cout << "ERROR OF KEY:" << c << std::endl << "ACTUAL VALUE: "
+                  << numbers_with_c << ", EXPECTED KEY " << expected->first
+                  << " WITH VALUE " << expected->second << std::endl;
+        exit (EXIT_FAILURE);
+      }
+      ++expected;
+      delete pair.first;
+      delete pair.second;
+    }
+    if (live_numbers != N)
+    {
+      std::cout << "ERROR: " << live_numbers - N
+                << " PAIRS OF THE CHAIN WERE NOT FREED" << std::endl;
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  for (InputPair &pair : numbers)
+  {
+    delete pair.first;
+  }
+  std::cout << "PASSED THE TEST!" << std::endl;
+
+  return 0;
+}